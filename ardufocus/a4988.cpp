@@ -19,13 +19,24 @@
 
 #include "a4988.h"
 
+// Minimum timings from the data sheets (nS), the pulse width applies to both
+// the high and low phases of STEP
+#define A4988_SETUP_NS      400
+#define A4988_PULSE_NS      1000
+#define A4988_WAKEUP_NS     1000000L
+
+#define DRV8825_SETUP_NS    1300
+#define DRV8825_PULSE_NS    1900
+#define DRV8825_WAKEUP_NS   1700000L
+
 /**
  * @brief Initialize Arduino pins for A4988 step stick according to pinout in config.h
  * @details Configure Arduino pins, so we are able to drive the stepper motor. 
  * This routine sets the step resolution.  
  *
  */
-void a4988::init()
+template<a4988_variant_t V>
+void a4988<V>::init()
 {
   stepper::init();
 
@@ -54,15 +65,15 @@ void a4988::init()
  * @details [long description]
  *
  */
-void a4988::halt()
+template<a4988_variant_t V>
+void a4988<V>::halt()
 {
 
   stepper::halt();
   m_sleep_timeout_cnt = ((m_sleep_timeout * 1000000UL) / TIMER0_TICK);
   IO::write(m_pinout.step, LOW);
 
-  // A4988: 400ns, A8825: 1.3us
-  util::delay_2us();
+  wait_setup();
 }
 
 
@@ -71,15 +82,17 @@ void a4988::halt()
  * @details Use the microstepping resolution pins to configure a "full step" per pulse.
  *
  */
-void a4988::set_full_step()
+template<a4988_variant_t V>
+void a4988<V>::set_full_step()
 {
   m_mode = 0x00;
+  IO::batch_begin();
   IO::write(m_pinout.ms1, LOW);
   IO::write(m_pinout.ms2, LOW);
   IO::write(m_pinout.ms3, LOW);
+  IO::batch_end();
 
-  // A4988: 400ns, A8825: 1.3us
-  util::delay_2us();
+  wait_setup();
 }
 
 
@@ -88,15 +101,17 @@ void a4988::set_full_step()
  * @details Use the microstepping resolutions pins to configure a "half step" per pulse resolution.
  *
  */
-void a4988::set_half_step()
+template<a4988_variant_t V>
+void a4988<V>::set_half_step()
 {
   m_mode = 0xFF;
+  IO::batch_begin();
   IO::write(m_pinout.ms1, HIGH);
   IO::write(m_pinout.ms2, LOW);
   IO::write(m_pinout.ms3, LOW);
+  IO::batch_end();
 
-  // A4988: 400ns, A8825: 1.3us
-  util::delay_2us();
+  wait_setup();
 }
 
 /**
@@ -104,15 +119,17 @@ void a4988::set_half_step()
  * @details Use the microstepping resolutions pins to configure a "half step" per pulse resolution.
  *
  */
-void a4988::set_quarter_step()
+template<a4988_variant_t V>
+void a4988<V>::set_quarter_step()
 {
   m_mode = 0xFF;
+  IO::batch_begin();
   IO::write(m_pinout.ms1, LOW);
   IO::write(m_pinout.ms2, HIGH);
   IO::write(m_pinout.ms3, LOW);
+  IO::batch_end();
 
-  // A4988: 400ns, A8825: 1.3us
-  util::delay_2us();
+  wait_setup();
 }
 
 // Disable 'implicit fall-through' warning, as the switch statements fall-through on purpose.
@@ -123,14 +140,14 @@ void a4988::set_quarter_step()
  * @details [long description]
  *
  */
-bool a4988::step_cw()
+template<a4988_variant_t V>
+bool a4988<V>::step_cw()
 {
   switch(IO::read(m_pinout.direction))
   {
     case LOW:
       IO::write(m_pinout.direction, HIGH);
-      // A4988: 400ns, A8825: 1.3us
-      util::delay_2us();
+      wait_setup();
 
     case HIGH:
       ;
@@ -146,7 +163,8 @@ bool a4988::step_cw()
  * @details [long description]
  *
  */
-bool a4988::step_ccw()
+template<a4988_variant_t V>
+bool a4988<V>::step_ccw()
 {
   switch(IO::read(m_pinout.direction))
   {
@@ -155,8 +173,7 @@ bool a4988::step_ccw()
 
     case HIGH:
       IO::write(m_pinout.direction, LOW);
-      // A4988: 400ns, A8825: 1.3us
-      util::delay_2us();
+      wait_setup();
 
     default:
       return step();
@@ -171,12 +188,12 @@ bool a4988::step_ccw()
  * @details Writes a pulse on the output pin, to advance the motor according to the set resolution.
  *
  */
-bool a4988::step()
+template<a4988_variant_t V>
+bool a4988<V>::step()
 {
-  if(m_sleep_when_idle && !IO::read(m_pinout.sleep)) {
+  if(!IO::read(m_pinout.sleep)) {
     IO::write(m_pinout.sleep, HIGH);
-    // A4988: 200ns, A8825: 1.7ms
-    util::delay_2ms();
+    wait_wakeup();
   }
 
   /*
@@ -186,30 +203,86 @@ bool a4988::step()
    * condition.
    */
 
-  // A4988: 1us, A8825: 1.9us
   IO::write(m_pinout.step, HIGH);
-  util::delay_2us();
+  wait_pulse();
 
-  // A4988: 1us, A8825: 1.9us
+  // The low phase needs no wait, the next pulse is at least one Timer0 tick
+  // away which is way longer than the minimum pulse width
   IO::write(m_pinout.step, LOW);
-  util::delay_2us();
 
   return true;
 }
 
 
+/**
+ * @brief Direction and resolution setup time before a STEP pulse
+ *
+ */
+template<a4988_variant_t V>
+void a4988<V>::wait_setup()
+{
+  util::delay_ns<(V == VARIANT_DRV8825) ? DRV8825_SETUP_NS : A4988_SETUP_NS>();
+}
+
+
+/**
+ * @brief Minimum STEP pulse width
+ *
+ */
+template<a4988_variant_t V>
+void a4988<V>::wait_pulse()
+{
+  util::delay_ns<(V == VARIANT_DRV8825) ? DRV8825_PULSE_NS : A4988_PULSE_NS>();
+}
+
+
+/**
+ * @brief Charge pump settling time when leaving sleep mode
+ *
+ */
+template<a4988_variant_t V>
+void a4988<V>::wait_wakeup()
+{
+  util::delay_ns<(V == VARIANT_DRV8825) ? DRV8825_WAKEUP_NS : A4988_WAKEUP_NS>();
+}
+
+
 /**
  * @brief [brief description]
  * @details [long description]
  *
  */
-void a4988::sleep()
+template<a4988_variant_t V>
+void a4988<V>::sleep()
 {
   if(m_sleep_when_idle && m_sleep_timeout_cnt) {
     --m_sleep_timeout_cnt;
 
-    if(!m_sleep_timeout_cnt) {
-      IO::write(m_pinout.sleep, LOW);
-    }
+    if(!m_sleep_timeout_cnt) { power_down(); }
   }
 }
+
+
+/**
+ * @brief Cut the motor current immediately
+ * @details Puts the driver to sleep without waiting for the sleep timeout,
+ * the next step() call will wake it up again.
+ *
+ */
+template<a4988_variant_t V>
+void a4988<V>::power_down()
+{
+  m_sleep_timeout_cnt = 0;
+  IO::write(m_pinout.sleep, LOW);
+}
+
+
+// Only the variants in use are emitted
+#if defined(MOTOR1_USE_DRV8825_DRIVER) || defined(MOTOR2_USE_DRV8825_DRIVER)
+  template class a4988<VARIANT_DRV8825>;
+#endif
+
+#if (defined(MOTOR1_USE_A4988_DRIVER) && !defined(MOTOR1_USE_DRV8825_DRIVER)) \
+  || (defined(MOTOR2_USE_A4988_DRIVER) && !defined(MOTOR2_USE_DRV8825_DRIVER))
+  template class a4988<VARIANT_A4988>;
+#endif
@@ -26,6 +26,10 @@
 #include "macro.h"
 #include "utility.h"
 
+// The DRV8825 is pin compatible but needs slower timings
+enum a4988_variant_t { VARIANT_A4988, VARIANT_DRV8825 };
+
+template<a4988_variant_t V = VARIANT_A4988>
 class a4988: public stepper
 {
   public:
@@ -65,18 +69,23 @@ class a4988: public stepper
 
   private:
     force_inline speed bool step();
+    force_inline void wait_setup();
+    force_inline void wait_pulse();
+    force_inline void wait_wakeup();
 
   public:
     virtual void init();
     virtual void halt();
     virtual void sleep();
+    virtual void power_down();
     virtual void set_full_step();
     virtual void set_half_step();
     virtual void set_quarter_step();
     virtual speed bool step_cw();
     virtual speed bool step_ccw();
 
-    inline a4988(pinout_t const& pinout) : m_pinout({ pinout }) { ; }
+    inline a4988(pinout_t const& pinout)
+      : m_pinout({ pinout }) { ; }
 };
 
 #endif
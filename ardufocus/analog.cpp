@@ -123,6 +123,6 @@ void Analog::setup()
     DIDR0 |= bit(ADC5D) | bit(ADC4D);
   }
 
-  // wait a bit
-  util::delay_5ms();
+  // No need to wait for the reference to settle here, the first conversion is
+  // only started by the Timer2 scheduler well after the boot is done.
 }
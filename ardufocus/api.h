@@ -26,11 +26,18 @@
 #include <avr/wdt.h>
 #include <util/delay.h>
 #include "analog.h"
+#include "ds18b20.h"
 #include "stepper.h"
+#include "isr.h"
 #include "dtr.h"
+#include "profile.h"
 
 //TODO https://stackoverflow.com/questions/553682/when-can-i-use-a-forward-declaration
 
+#ifdef USE_ISR_LOAD_SHEDDING
+extern volatile uint16_t g_isr_overloads;
+#endif
+
 #ifdef MOTOR1_HAS_DRIVER
 extern stepper* g_motor1;
 #endif
@@ -44,22 +51,61 @@ enum motor_t {
   MOTOR_TWO
 };
 
+struct sample_t {
+  uint32_t timestamp;
+  uint32_t position;
+  bool     moving;
+};
+
 class api {
   public:
      api() {;}
     ~api() {;}
 
+    #ifdef USE_DS18B20
+    // Conversions run continuously in the background
+    static void update_temperature() { ; }
+
+    static float get_temperature(const uint8_t& sensor = 0) {
+      const int16_t t = DS18B20::read(sensor);
+      return (t == DS18B20_INVALID) ? -13.37F : t / 16.0F;
+    }
+
+    #else
     static void update_temperature() {
       Analog::read_async(NTC_ADC_CHANNEL);
     }
 
-    static float get_temperature() {
+    static float get_temperature(const uint8_t& sensor = 0) {
+      (void) sensor;
+
       #ifdef START_TEMP_CONVERSION_ON_EVERY_GET
       update_temperature();
       #endif
 
       return util::steinhart(Analog::read(NTC_ADC_CHANNEL));
     }
+    #endif
+
+    static bool motor_home(const motor_t& idx) {
+      switch(idx) {
+        case MOTOR_ONE:
+          #ifdef MOTOR1_HAS_DRIVER
+          return g_motor1->home();
+          #endif
+          break;
+
+        case MOTOR_TWO:
+          #ifdef MOTOR2_HAS_DRIVER
+          return g_motor2->home();
+          #endif
+          break;
+
+        default: break;
+      }
+
+      return false;
+    }
 
     static void motor_start(const motor_t& idx) {
       switch(idx) {
@@ -79,6 +125,24 @@ class api {
       }
     }
 
+    static void motor_move_by(const motor_t& idx, const int32_t& delta) {
+      switch(idx) {
+        case MOTOR_ONE:
+          #ifdef MOTOR1_HAS_DRIVER
+          g_motor1->move_by(delta);
+          #endif
+          break;
+
+        case MOTOR_TWO:
+          #ifdef MOTOR2_HAS_DRIVER
+          g_motor2->move_by(delta);
+          #endif
+          break;
+
+        default: break;
+      }
+    }
+
     static void motor_stop(const motor_t& idx) {
       switch(idx) {
         case MOTOR_ONE:
@@ -95,8 +159,31 @@ class api {
 
         default: break;
       }
+
+      // Halting restarts the sleep countdown, which runs on the step timer
+      timer0_wake();
     }
 
+    #ifdef HAS_TMC2209
+    static uint16_t motor_get_stalls(const motor_t& idx) {
+      switch(idx) {
+        case MOTOR_ONE:
+          #ifdef MOTOR1_HAS_DRIVER
+          return g_motor1->get_stalls();
+          #endif
+          break;
+
+        case MOTOR_TWO:
+          #ifdef MOTOR2_HAS_DRIVER
+          return g_motor2->get_stalls();
+          #endif
+          break;
+      }
+
+      return 0;
+    }
+    #endif
+
     static uint8_t motor_get_speed(const motor_t& idx) {
       switch(idx) {
         case MOTOR_ONE:
@@ -188,6 +275,83 @@ class api {
       return 0;
     }
 
+    /**
+     * @brief   Position and state of a motor at a single instant
+     * @details The step ISR is held off while reading thus the timestamp is
+     *          exact, whatever the time the reply spends queued afterwards.
+     */
+    static sample_t motor_get_sample(const motor_t& idx) {
+      sample_t s;
+
+      ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        s.timestamp = clock_us();
+        s.position  = motor_get_position(idx);
+        s.moving    = motor_is_moving(idx);
+      }
+
+      return s;
+    }
+
+    static void set_clock(const uint32_t& us) {
+      clock_sync(us);
+    }
+
+    #ifdef USE_ADAPTIVE_SLEEP
+    static uint8_t motor_get_sleep_timeout(const motor_t& idx) {
+      switch(idx) {
+        case MOTOR_ONE:
+          #ifdef MOTOR1_HAS_DRIVER
+          return g_motor1->get_sleep_timeout();
+          #endif
+          break;
+
+        case MOTOR_TWO:
+          #ifdef MOTOR2_HAS_DRIVER
+          return g_motor2->get_sleep_timeout();
+          #endif
+          break;
+      }
+
+      return 0;
+    }
+
+    static uint16_t motor_get_sleep_hits(const motor_t& idx) {
+      switch(idx) {
+        case MOTOR_ONE:
+          #ifdef MOTOR1_HAS_DRIVER
+          return g_motor1->get_sleep_hits();
+          #endif
+          break;
+
+        case MOTOR_TWO:
+          #ifdef MOTOR2_HAS_DRIVER
+          return g_motor2->get_sleep_hits();
+          #endif
+          break;
+      }
+
+      return 0;
+    }
+
+    static uint16_t motor_get_sleep_misses(const motor_t& idx) {
+      switch(idx) {
+        case MOTOR_ONE:
+          #ifdef MOTOR1_HAS_DRIVER
+          return g_motor1->get_sleep_misses();
+          #endif
+          break;
+
+        case MOTOR_TWO:
+          #ifdef MOTOR2_HAS_DRIVER
+          return g_motor2->get_sleep_misses();
+          #endif
+          break;
+      }
+
+      return 0;
+    }
+    #endif
+
     static void motor_set_speed(const motor_t& idx, const uint32_t& value) {
       switch(idx) {
         case MOTOR_ONE:
@@ -219,6 +383,7 @@ class api {
           } else {
             g_motor1->set_full_step();
           }
+          g_motor1->set_mode_cmd(MODE_CMD_FULL);
           #endif
           break;
 
@@ -231,6 +396,7 @@ class api {
           } else {
             g_motor2->set_full_step();
           }
+          g_motor2->set_mode_cmd(MODE_CMD_FULL);
           #endif
           break;
 
@@ -244,12 +410,14 @@ class api {
         case MOTOR_ONE:
           #ifdef MOTOR1_HAS_DRIVER
           g_motor1->set_half_step();
+          g_motor1->set_mode_cmd(MODE_CMD_HALF);
           #endif
           break;
 
         case MOTOR_TWO:
           #ifdef MOTOR2_HAS_DRIVER
           g_motor2->set_half_step();
+          g_motor2->set_mode_cmd(MODE_CMD_HALF);
           #endif
           break;
 
@@ -263,11 +431,13 @@ class api {
         case MOTOR_ONE:
           #ifdef MOTOR1_HAS_DRIVER
           g_motor1->set_quarter_step();
+          g_motor1->set_mode_cmd(MODE_CMD_QUARTER);
           #endif
           break;
         case MOTOR_TWO:
           #ifdef MOTOR2_HAS_DRIVER
           g_motor2->set_quarter_step();
+          g_motor2->set_mode_cmd(MODE_CMD_QUARTER);
           #endif
           break;
         default:
@@ -313,6 +483,37 @@ class api {
       }
     }
 
+    static uint16_t get_eeprom_saves() { return eeprom_save_count(); }
+
+    #ifdef USE_ISR_LOAD_SHEDDING
+    static uint16_t get_isr_overloads() {
+      uint16_t n;
+      ATOMIC_BLOCK(ATOMIC_RESTORESTATE) { n = g_isr_overloads; }
+      return n;
+    }
+    #endif
+
+    #ifdef DEBUG_ISR_PROFILE
+    static profile_t get_profile() {
+      profile_t p;
+      ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        p.isr_last  = g_profile.isr_last;
+        p.isr_max   = g_profile.isr_max;
+        p.cmd_last  = g_profile.cmd_last;
+        p.cmd_max   = g_profile.cmd_max;
+        p.loop_cnt  = g_profile.loop_cnt;
+        p.loop_rate = g_profile.loop_rate;
+      }
+      return p;
+    }
+    #endif
+
+    #ifdef DEBUG_BOOT_PROFILE
+    static uint32_t get_boot_time(const uint8_t& phase) {
+      return (phase < BOOT_PHASES) ? g_boot[phase] : 0;
+    }
+    #endif
+
     #ifdef ENABLE_REMOTE_RESET
     static void system_reset(const uint32_t& wait) {
       wdt_disable();
@@ -323,6 +524,148 @@ class api {
     }
     #endif
 
+    #ifdef USE_FOCUS_PRESETS
+    static uint32_t preset_get(const motor_t& idx, const uint8_t& n) {
+      if(n >= FOCUS_PRESETS) { return 0; }
+      return g_config.preset[idx][n].value;
+    }
+
+    static void preset_set(const motor_t& idx, const uint8_t& n, const preset_kind_t& kind, const uint32_t& value) {
+      if(n >= FOCUS_PRESETS) { return; }
+      g_config.preset[idx][n].kind  = kind;
+      g_config.preset[idx][n].value = value;
+      eeprom_defer_save();
+    }
+
+    /**
+     * @brief   Start a move to a preset
+     * @details Filter offsets move by the difference to the offset of the
+     *          last recalled filter, which becomes the active one.
+     */
+    static bool preset_recall(const motor_t& idx, const uint8_t& n) {
+      if(n >= FOCUS_PRESETS) { return false; }
+      const preset_t& p = g_config.preset[idx][n];
+
+      switch(p.kind) {
+        case PRESET_POSITION:
+          motor_set_target(idx, p.value);
+          motor_start(idx);
+          break;
+
+        case PRESET_OFFSET: {
+          // The active offset is recorded before moving, the map is written
+          // by the main loop once the move is over
+          const int32_t delta = (int32_t) p.value - g_config.preset_offset[idx];
+          g_config.preset_offset[idx] = p.value;
+          eeprom_defer_save();
+          motor_move_by(idx, delta);
+          break;
+        }
+
+        default:
+          return false;
+      }
+
+      return true;
+    }
+    #endif
+
+    #ifdef USE_FOCUS_LEARNING
+    /**
+     * @brief   Record the current position as the best focus
+     * @details Ignored while moving or when the temperature is unknown.
+     */
+    static bool tempfit_mark(const motor_t& idx) {
+      if(motor_is_moving(idx)) { return false; }
+
+      #ifdef USE_DS18B20
+      const int16_t t = DS18B20::read(0);
+      if(t == DS18B20_INVALID) { return false; }
+      #else
+      const int16_t t = get_temperature() * 16.0F;
+      #endif
+
+      tempfit_add(&g_config.tempfit[idx], t, motor_get_position(idx));
+      eeprom_defer_save();
+      return true;
+    }
+
+    static void tempfit_clear(const motor_t& idx) {
+      tempfit_reset(&g_config.tempfit[idx]);
+      eeprom_defer_save();
+    }
+
+    static int32_t tempfit_get_slope(const motor_t& idx) {
+      return tempfit_slope(&g_config.tempfit[idx]);
+    }
+
+    static uint8_t tempfit_get_confidence(const motor_t& idx) {
+      return tempfit_confidence(&g_config.tempfit[idx]);
+    }
+
+    static uint16_t tempfit_get_samples(const motor_t& idx) {
+      return g_config.tempfit[idx].n;
+    }
+    #endif
+
+    #ifdef USE_SOFT_LIMITS
+    // Soft limit fields, 0 is the lower limit, 1 the upper and 2 the zone width
+    static uint32_t limits_get(const motor_t& idx, const uint8_t& n) {
+      const limits_t& l = g_config.limits[idx];
+      switch(n) {
+        case 0:  return l.lower;
+        case 1:  return l.upper;
+        case 2:  return l.zone;
+        default: return 0;
+      }
+    }
+
+    /**
+     * @brief   Change one of the soft limits of a motor
+     * @details A lower limit above the upper one is refused, a move in
+     *          progress is clamped to the new limits.
+     */
+    static bool limits_set(const motor_t& idx, const uint8_t& n, const uint32_t& value) {
+      limits_t l = g_config.limits[idx];
+      switch(n) {
+        case 0:  l.lower = value; break;
+        case 1:  l.upper = value; break;
+        case 2:  l.zone  = value; break;
+        default: return false;
+      }
+
+      if(l.lower > l.upper) { return false; }
+
+      switch(idx) {
+        case MOTOR_ONE:
+          #ifdef MOTOR1_HAS_DRIVER
+          g_motor1->set_limits(l.lower, l.upper, l.zone);
+          #endif
+          break;
+
+        case MOTOR_TWO:
+          #ifdef MOTOR2_HAS_DRIVER
+          g_motor2->set_limits(l.lower, l.upper, l.zone);
+          #endif
+          break;
+      }
+
+      g_config.limits[idx] = l;
+      eeprom_defer_save();
+      return true;
+    }
+    #endif
+
+    #ifdef USE_RS485_MULTIDROP
+    static uint8_t get_bus_address() { return g_config.bus_address; }
+
+    static void set_bus_address(const uint8_t& value) {
+      if(value == RS485_BROADCAST_ADDRESS || value == 0xFF) { return; }
+      g_config.bus_address = value;
+      eeprom_defer_save();
+    }
+    #endif
+
     #ifdef ENABLE_DTR_RESET
     static void    set_dtr_reset(const bool& value) { dtr_reset(value);       }
     static uint8_t get_dtr_reset()                  { return dtr_reset_get(); }
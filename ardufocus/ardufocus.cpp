@@ -44,79 +44,134 @@ int main(void)
   #endif
 
   // --------------------------------------------------------------------------
-  // EEPROM -------------------------------------------------------------------
+  // Disable Watchdog ---------------------------------------------------------
   // --------------------------------------------------------------------------
-  eeprom_init(&g_config);
+  wdt_disable();
 
 
   // --------------------------------------------------------------------------
-  // DTR Serial Reset ---------------------------------------------------------
+  // Disable global interrupts ------------------------------------------------
   // --------------------------------------------------------------------------
-  dtr_disable();
+  cli();
 
 
   // --------------------------------------------------------------------------
-  // Disable Watchdog ---------------------------------------------------------
+  // Timer2 ISR init routine --------------------------------------------------
   // --------------------------------------------------------------------------
-  wdt_disable();
+  // Cleanup all the relevant registers
+  TCCR2A = 0; TCCR2B = 0; TIMSK2 = 0;
+  TIFR2  = 0; TCNT2  = 0; OCR2A  = 0; OCR2B = 0;
+
+  // set waveform generation mode to CTC, top OCR0A
+  TCCR2A |= bit(WGM21);
+
+  // set clock select to clk/64
+  TCCR2B |= bit(CS22);
+
+  // output Compare A Match Interrupt Enable
+  TIMSK2 |= bit(OCIE2A);
+
+  // sets the Output Compare Register values
+  OCR2A = TIMER2_OCRA;
 
 
   // --------------------------------------------------------------------------
-  // Disable global interrupts ------------------------------------------------
+  // Enable global interrupts -------------------------------------------------
   // --------------------------------------------------------------------------
-  cli();
+  // Only the uptime clock and the serial port are active at this point, frames
+  // received during setup are buffered. The background tasks and the step ISR
+  // are enabled once everything they use is ready.
+  sei();
 
 
   // --------------------------------------------------------------------------
-  // Load settings ------------------------------------------------------------
+  // EEPROM -------------------------------------------------------------------
   // --------------------------------------------------------------------------
-  #ifdef MOTOR1_HAS_DRIVER
-    g_motor1->set_current_position(g_config.position_m1);
-  #endif
+  eeprom_init(&g_config);
 
-  #ifdef MOTOR2_HAS_DRIVER
-    g_motor2->set_current_position(g_config.position_m2);
+  #ifdef USE_RS485_MULTIDROP
+    // Units fresh from the factory or upgraded from a previous
+    // version will not have a valid bus address on the EEPROM
+    if(g_config.bus_address == RS485_BROADCAST_ADDRESS || g_config.bus_address == 0xFF) {
+      g_config.bus_address = RS485_DEFAULT_ADDRESS;
+      eeprom_save(&g_config);
+    }
   #endif
 
+  #ifdef USE_FOCUS_PRESETS
+    // The preset table is appended to the map, when upgrading from a build
+    // without it the area holds whatever was there before
+    if(g_config.preset_header != PRESET_MAGIC_HEADER) {
+      g_config.preset_header = PRESET_MAGIC_HEADER;
+      memset(g_config.preset_offset, 0, sizeof(g_config.preset_offset));
+      memset(g_config.preset, 0, sizeof(g_config.preset));
+      eeprom_save(&g_config);
+    }
+  #endif
 
-  // --------------------------------------------------------------------------
-  // Timer0 ISR init routine --------------------------------------------------
-  // --------------------------------------------------------------------------
-  // Cleanup all the relevant registers
-  TCCR0A = 0; TCCR0B = 0; TIMSK0 = 0;
-  TIFR0  = 0; TCNT0  = 0; OCR0A  = 0; OCR0B = 0;
+  #ifdef USE_FOCUS_LEARNING
+    if(g_config.tempfit_header != TEMPFIT_MAGIC_HEADER) {
+      g_config.tempfit_header = TEMPFIT_MAGIC_HEADER;
+      tempfit_reset(&g_config.tempfit[0]);
+      tempfit_reset(&g_config.tempfit[1]);
+      eeprom_save(&g_config);
+    }
+  #endif
 
-  // set waveform generation mode to CTC, top OCR0A
-  TCCR0A |= bit(WGM01);
+  #ifdef USE_SOFT_LIMITS
+    // Until the host sets them the limits span the whole counter
+    if(g_config.limits_header != LIMITS_MAGIC_HEADER) {
+      g_config.limits_header = LIMITS_MAGIC_HEADER;
+      for(uint8_t i = 0; i < 2; i++) {
+        g_config.limits[i].lower = 0;
+        #ifdef HIGH_RESOLUTION_MODE
+        g_config.limits[i].upper = UINT32_MAX;
+        #else
+        g_config.limits[i].upper = UINT16_MAX;
+        #endif
+        g_config.limits[i].zone  = 0;
+      }
+      eeprom_save(&g_config);
+    }
+  #endif
 
-  // set clock select to clk/64
-  TCCR0B |= bit(CS01) | bit(CS00);
+  #ifdef DEBUG_BOOT_PROFILE
+    profile_boot(BOOT_EEPROM);
+  #endif
 
-  // output Compare A Match Interrupt Enable
-  TIMSK0 |= bit(OCIE0A);
 
-  // sets the Output Compare Register values
-  OCR0A = TIMER0_OCRA;
+  // --------------------------------------------------------------------------
+  // DTR Serial Reset ---------------------------------------------------------
+  // --------------------------------------------------------------------------
+  dtr_disable();
 
 
   // --------------------------------------------------------------------------
-  // Timer2 ISR init routine --------------------------------------------------
+  // Load settings ------------------------------------------------------------
   // --------------------------------------------------------------------------
-  // Cleanup all the relevant registers
-  TCCR2A = 0; TCCR2B = 0; TIMSK2 = 0;
-  TIFR2  = 0; TCNT2  = 0; OCR2A  = 0; OCR2B = 0;
+  #ifdef MOTOR1_HAS_DRIVER
+    g_motor1->set_current_position(g_config.position_m1);
+  #endif
 
-  // set waveform generation mode to CTC, top OCR0A
-  TCCR2A |= bit(WGM21);
+  #ifdef MOTOR2_HAS_DRIVER
+    g_motor2->set_current_position(g_config.position_m2);
+  #endif
 
-  // set clock select to clk/64
-  TCCR2B |= bit(CS22) | bit(CS21) | bit(CS20);
 
-  // output Compare A Match Interrupt Enable
-  TIMSK2 |= bit(OCIE2A);
+  // --------------------------------------------------------------------------
+  // Output expander ----------------------------------------------------------
+  // --------------------------------------------------------------------------
+  #ifdef USE_SHIFT_REGISTER
+    ShiftReg::setup();
+  #endif
 
-  // sets the Output Compare Register values
-  OCR2A = TIMER2_OCRA;
+
+  // --------------------------------------------------------------------------
+  // Timer1 ISR profiler ------------------------------------------------------
+  // --------------------------------------------------------------------------
+  #ifdef DEBUG_ISR_PROFILE
+    profile_init();
+  #endif
 
 
   // --------------------------------------------------------------------------
@@ -124,12 +179,24 @@ int main(void)
   // --------------------------------------------------------------------------
   Analog::setup();
 
+  #ifdef USE_DS18B20
+    DS18B20::setup();
+  #endif
+
+  #ifdef DEBUG_BOOT_PROFILE
+    profile_boot(BOOT_SENSORS);
+  #endif
+
 
   // --------------------------------------------------------------------------
   // User interface -----------------------------------------------------------
   // --------------------------------------------------------------------------
   UI::setup();
 
+  #ifdef DEBUG_BOOT_PROFILE
+    profile_boot(BOOT_UI);
+  #endif
+
 
   // --------------------------------------------------------------------------
   // Motor #1 init routine ----------------------------------------------------
@@ -141,6 +208,10 @@ int main(void)
     g_motor1->set_max_speed(MOTOR1_MAX_SPEED);
     g_motor1->set_min_speed(MOTOR1_MIN_SPEED);
     g_motor1->init();
+
+    #ifdef USE_SOFT_LIMITS
+    g_motor1->set_limits(g_config.limits[0].lower, g_config.limits[0].upper, g_config.limits[0].zone);
+    #endif
   #endif
 
   #ifdef MOTOR2_HAS_DRIVER
@@ -150,13 +221,53 @@ int main(void)
     g_motor2->set_max_speed(MOTOR2_MAX_SPEED);
     g_motor2->set_min_speed(MOTOR2_MIN_SPEED);
     g_motor2->init();
+
+    #ifdef USE_SOFT_LIMITS
+    g_motor2->set_limits(g_config.limits[1].lower, g_config.limits[1].upper, g_config.limits[1].zone);
+    #endif
   #endif
 
 
   // --------------------------------------------------------------------------
-  // Enable global interrupts -------------------------------------------------
+  // Warm restart -------------------------------------------------------------
   // --------------------------------------------------------------------------
-  sei();
+  // After anything but a power-on the RAM mirror is more recent than the
+  // EEPROM, a move that was interrupted by the reset is resumed
+  warmboot_load();
+
+  #ifdef DEBUG_BOOT_PROFILE
+    profile_boot(BOOT_MOTORS);
+  #endif
+
+
+  // --------------------------------------------------------------------------
+  // Timer0 ISR init routine --------------------------------------------------
+  // --------------------------------------------------------------------------
+  // Cleanup all the relevant registers
+  TCCR0A = 0; TCCR0B = 0; TIMSK0 = 0;
+  TIFR0  = 0; TCNT0  = 0; OCR0A  = 0; OCR0B = 0;
+
+  // set waveform generation mode to CTC, top OCR0A
+  TCCR0A |= bit(WGM01);
+
+  // set clock select to clk/64, the ISR stops it while the motors are idle
+  TCCR0B |= TIMER0_CS;
+
+  // output Compare A Match Interrupt Enable
+  TIMSK0 |= bit(OCIE0A);
+
+  // sets the Output Compare Register values
+  OCR0A = TIMER0_OCRA;
+
+
+  // --------------------------------------------------------------------------
+  // Background tasks ---------------------------------------------------------
+  // --------------------------------------------------------------------------
+  g_isr_tasks = true;
+
+  #ifdef DEBUG_BOOT_PROFILE
+    profile_boot(BOOT_READY);
+  #endif
 
 
   // --------------------------------------------------------------------------
@@ -164,7 +275,30 @@ int main(void)
   // --------------------------------------------------------------------------
   for(;;)
   {
+    #ifdef DEBUG_ISR_PROFILE
+    profile_loop();
+    #endif
+
     comms.receive();
+    comms.banner();
+
+    #ifdef USE_WARM_RESTART
+    warmboot_save();
+    #endif
+
+    // Writing stalls the step ISR for milliseconds, settings and positions
+    // are saved once every motor is idle
+    #ifdef MOTOR1_HAS_DRIVER
+    if(! g_motor1->is_moving())
+    #endif
+    #ifdef MOTOR2_HAS_DRIVER
+    if(! g_motor2->is_moving())
+    #endif
+    eeprom_flush(&g_config);
+
+    #ifdef USE_SERIAL_AUX
+    comms_aux.receive();
+    #endif
 
     UI::update_display();
     UI::fetch_key_state();
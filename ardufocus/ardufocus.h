@@ -29,7 +29,11 @@
 #include "stepper.h"
 #include "motordrv.h"
 #include "analog.h"
+#include "ds18b20.h"
+#include "isr.h"
 #include "moonlite.h"
+#include "profile.h"
 #include "ui.h"
+#include "warmboot.h"
 
 #endif
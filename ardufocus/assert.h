@@ -25,16 +25,22 @@
 #define TIMER0_FREQ 5000L // Hz
 #define TIMER0_OCRA (((F_CPU/TIMER0_PSCL) / TIMER0_FREQ)  -1)
 #define TIMER0_TICK (1000000L  / TIMER0_FREQ) // uS
+#define TIMER0_CS   (bit(CS01) | bit(CS00)) // clk/64, cleared to stop
 
-#define TIMER2_PSCL 1024
-#define TIMER2_FREQ 160L // Hz
-#define TIMER2_OCRA (((F_CPU/TIMER0_PSCL) / TIMER0_FREQ)  -1)
-#define TIMER2_TICK (1000000L  / TIMER0_FREQ) // uS
+#define TIMER2_PSCL 64
+#define TIMER2_FREQ 1000L // Hz, also the uptime clock
+#define TIMER2_OCRA (((F_CPU/TIMER2_PSCL) / TIMER2_FREQ)  -1)
+#define TIMER2_TICK (1000000L  / TIMER2_FREQ) // uS
+#define TIMER2_TASK_DIV 3 // the background tasks run at ~333Hz
 
 #define DEFAULT_MAX_SPEED    250
 #define DEFAULT_MIN_SPEED     25
 #define DEFAULT_SLEEP_TIMEOUT 15
 
+#if (TIMER2_OCRA > 255)
+  #error F_CPU is too high for the Timer2 millisecond clock.
+#endif
+
 // User warnings --------------------------------------------------------------
 #if defined(ENABLE_REMOTE_RESET)
   //#warning Remote reset is enabled, make sure your bootloader is updated !
@@ -53,30 +59,170 @@
   #endif
 #endif
 
+#if defined(USE_SERIAL_AUX)
+  #if !defined(__AVR_ATmega328PB__)
+    #error USE_SERIAL_AUX is only available on the ATmega328PB.
+    #error Please review the config.h file.
+  #endif
+
+  #ifndef SERIAL_AUX_BAUDRATE
+    #define SERIAL_AUX_BAUDRATE 57600L
+  #endif
+#endif
+
+#if defined(USE_RS485_MULTIDROP)
+  #if !defined(RS485_DE_PINOUT)
+    #error USE_RS485_MULTIDROP is active but RS485_DE_PINOUT is missing.
+    #error Please review the config.h file.
+  #endif
+
+  #if !defined(USE_EEPROM)
+    #error USE_RS485_MULTIDROP requiures USE_EEPROM to be active aswell.
+    #error Please review the config.h file.
+  #endif
+
+  #define RS485_BROADCAST_ADDRESS 0x00
+
+  #ifndef RS485_DEFAULT_ADDRESS
+    #define RS485_DEFAULT_ADDRESS 1
+  #endif
+
+  #if (RS485_DEFAULT_ADDRESS < 1) || (RS485_DEFAULT_ADDRESS > 254)
+    #error RS485_DEFAULT_ADDRESS must be between 1 and 254.
+    #error Please review the config.h file.
+  #endif
+#endif
+
+#if defined(USE_SHIFT_REGISTER)
+  #ifndef SHIFT_REGISTER_COUNT
+    #define SHIFT_REGISTER_COUNT 1
+  #elif (SHIFT_REGISTER_COUNT < 1) || (SHIFT_REGISTER_COUNT > 8)
+    #error SHIFT_REGISTER_COUNT must be between 1 and 8.
+    #error Please review the config.h file.
+  #endif
+
+  #ifndef SHIFT_REGISTER_LATCH_PINOUT
+    #define SHIFT_REGISTER_LATCH_PINOUT 10
+  #endif
+#endif
+
+#if defined(USE_FOCUS_PRESETS)
+  #if !defined(USE_EEPROM)
+    #error USE_FOCUS_PRESETS requiures USE_EEPROM to be active aswell.
+    #error Please review the config.h file.
+  #endif
+
+  #ifndef FOCUS_PRESETS
+    #define FOCUS_PRESETS 8
+  #elif (FOCUS_PRESETS < 1) || (FOCUS_PRESETS > 16)
+    #error FOCUS_PRESETS must be between 1 and 16.
+    #error Please review the config.h file.
+  #endif
+#endif
+
+#if defined(USE_FOCUS_LEARNING) && !defined(USE_EEPROM)
+  #error USE_FOCUS_LEARNING requiures USE_EEPROM to be active aswell.
+  #error Please review the config.h file.
+#endif
+
+#ifdef USE_ULN2003_ADAPTIVE_DRIVE
+  #ifndef ULN2003_FULL_STEP_SPEED
+    #define ULN2003_FULL_STEP_SPEED 150
+  #elif (ULN2003_FULL_STEP_SPEED < 4)
+    #error ULN2003_FULL_STEP_SPEED must be at least 4 steps/sec.
+    #error Please review the config.h file.
+  #endif
+#endif
+
+#if defined(USE_SOFT_LIMITS) && !defined(USE_EEPROM)
+  #error USE_SOFT_LIMITS requiures USE_EEPROM to be active aswell.
+  #error Please review the config.h file.
+#endif
+
+// Expander outputs are numbered above any real pin
+#define XIO_PIN_BASE 0x80
+#define XIO(n) (XIO_PIN_BASE + (n))
+
 // DRV8825 driver hack --------------------------------------------------------
 #if defined(MOTOR1_USE_DRV8825_DRIVER)
   #define MOTOR1_USE_A4988_DRIVER
 #endif
 
 // Duplicate driver check -----------------------------------------------------
-#if defined(MOTOR1_USE_A4988_DRIVER) && defined(MOTOR1_USE_ULN2003_DRIVER)
+#if (defined(MOTOR1_USE_A4988_DRIVER) + defined(MOTOR1_USE_ULN2003_DRIVER) + defined(MOTOR1_USE_TMC2209_DRIVER)) > 1
   #error More than one stepper driver selected for motor #1
   #error Please review the config.h file.
-#elif defined(MOTOR1_USE_A4988_DRIVER) || defined(MOTOR1_USE_ULN2003_DRIVER)
+#elif defined(MOTOR1_USE_A4988_DRIVER) || defined(MOTOR1_USE_ULN2003_DRIVER) || defined(MOTOR1_USE_TMC2209_DRIVER)
   #define MOTOR1_HAS_DRIVER
 #else
   // Motor 1 is optional
 #endif
 
-#if defined(MOTOR2_USE_A4988_DRIVER) && defined(MOTOR2_USE_ULN2003_DRIVER)
+#if (defined(MOTOR2_USE_A4988_DRIVER) + defined(MOTOR2_USE_ULN2003_DRIVER) + defined(MOTOR2_USE_TMC2209_DRIVER)) > 1
   #error More than one stepper driver selected for motor #2
   #error Please review the config.h file.
-#elif defined(MOTOR2_USE_A4988_DRIVER) || defined(MOTOR2_USE_ULN2003_DRIVER)
+#elif defined(MOTOR2_USE_A4988_DRIVER) || defined(MOTOR2_USE_ULN2003_DRIVER) || defined(MOTOR2_USE_TMC2209_DRIVER)
   #define MOTOR2_HAS_DRIVER
 #else
   // Motor 2 is optional
 #endif
 
+// TMC2209 driver -------------------------------------------------------------
+#if defined(MOTOR1_USE_TMC2209_DRIVER) || defined(MOTOR2_USE_TMC2209_DRIVER)
+  #define HAS_TMC2209
+
+  #ifndef TMC2209_RSENSE
+    #define TMC2209_RSENSE 110 // mR
+  #endif
+
+  #ifndef TMC2209_UART_BAUD
+    #define TMC2209_UART_BAUD 57600
+  #endif
+
+  #ifndef TMC2209_STALL_MIN_SPEED
+    #define TMC2209_STALL_MIN_SPEED 100
+  #elif (TMC2209_STALL_MIN_SPEED < 1)
+    #error TMC2209_STALL_MIN_SPEED must be at least 1 step/sec.
+    #error Please review the config.h file.
+  #endif
+#endif
+
+#ifdef MOTOR1_USE_TMC2209_DRIVER
+  #ifndef MOTOR1_TMC2209_ADDRESS
+    #define MOTOR1_TMC2209_ADDRESS 0
+  #endif
+
+  #ifndef MOTOR1_TMC2209_CURRENT
+    #define MOTOR1_TMC2209_CURRENT 500
+  #endif
+
+  #ifndef MOTOR1_TMC2209_MICROSTEPS
+    #define MOTOR1_TMC2209_MICROSTEPS 16
+  #endif
+
+  #ifndef MOTOR1_TMC2209_STALL_THRESHOLD
+    #define MOTOR1_TMC2209_STALL_THRESHOLD 0
+  #endif
+#endif
+
+#ifdef MOTOR2_USE_TMC2209_DRIVER
+  #ifndef MOTOR2_TMC2209_ADDRESS
+    #define MOTOR2_TMC2209_ADDRESS 1
+  #endif
+
+  #ifndef MOTOR2_TMC2209_CURRENT
+    #define MOTOR2_TMC2209_CURRENT 500
+  #endif
+
+  #ifndef MOTOR2_TMC2209_MICROSTEPS
+    #define MOTOR2_TMC2209_MICROSTEPS 16
+  #endif
+
+  #ifndef MOTOR2_TMC2209_STALL_THRESHOLD
+    #define MOTOR2_TMC2209_STALL_THRESHOLD 0
+  #endif
+#endif
+
 // DRV8825 driver hack --------------------------------------------------------
 #if defined(MOTOR2_USE_DRV8825_DRIVER)
   #define MOTOR2_USE_A4988_DRIVER
@@ -104,6 +250,103 @@
   #error Please review the config.h file.
 #endif
 
+// Shift register pins --------------------------------------------------------
+// True when pin p is on a pinout list, the list is padded up to six entries
+#define PINOUT_HAS_(p, a, b, c, d, e, f, ...) \
+  ((a) == (p) || (b) == (p) || (c) == (p) || (d) == (p) || (e) == (p) || (f) == (p))
+#define PINOUT_HAS(p, ...) PINOUT_HAS_(p, __VA_ARGS__, -1, -1, -1, -1, -1, -1)
+
+// The SPI master owns MOSI (11), MISO (12), SCK (13) and SS (10)
+#define PINOUT_HAS_SPI(...) (PINOUT_HAS(10, __VA_ARGS__) || PINOUT_HAS(11, __VA_ARGS__) || \
+  PINOUT_HAS(12, __VA_ARGS__) || PINOUT_HAS(13, __VA_ARGS__) || \
+  PINOUT_HAS(SHIFT_REGISTER_LATCH_PINOUT, __VA_ARGS__))
+
+#ifdef USE_SHIFT_REGISTER
+  #if defined(MOTOR1_HAS_DRIVER) && PINOUT_HAS_SPI(MOTOR1_PINOUT)
+    #error MOTOR1_PINOUT uses a pin taken by USE_SHIFT_REGISTER (10, 11, 12, 13 or the latch).
+    #error Please review the config.h file.
+  #endif
+
+  #if defined(MOTOR2_HAS_DRIVER) && PINOUT_HAS_SPI(MOTOR2_PINOUT)
+    #error MOTOR2_PINOUT uses a pin taken by USE_SHIFT_REGISTER (10, 11, 12, 13 or the latch).
+    #error Please review the config.h file.
+  #endif
+#endif
+
+// Power budget ---------------------------------------------------------------
+#if defined(USE_POWER_BUDGET) && (!defined(MOTOR1_HAS_DRIVER) || !defined(MOTOR2_HAS_DRIVER))
+  #warning USE_POWER_BUDGET requires two motors, the option will be ignored.
+  #undef USE_POWER_BUDGET
+#endif
+
+#ifdef USE_POWER_BUDGET
+  // Without figures a single motor at a time and no holding current
+  #ifndef POWER_BUDGET_MA
+    #define POWER_BUDGET_MA 500
+  #endif
+
+  #ifndef MOTOR1_RUN_MA
+    #define MOTOR1_RUN_MA POWER_BUDGET_MA
+  #endif
+
+  #ifndef MOTOR1_HOLD_MA
+    #define MOTOR1_HOLD_MA POWER_BUDGET_MA
+  #endif
+
+  #ifndef MOTOR2_RUN_MA
+    #define MOTOR2_RUN_MA POWER_BUDGET_MA
+  #endif
+
+  #ifndef MOTOR2_HOLD_MA
+    #define MOTOR2_HOLD_MA POWER_BUDGET_MA
+  #endif
+
+  #if (MOTOR1_RUN_MA > POWER_BUDGET_MA) || (MOTOR2_RUN_MA > POWER_BUDGET_MA)
+    #error MOTOR1_RUN_MA and MOTOR2_RUN_MA cannot exceed POWER_BUDGET_MA.
+    #error Please review the config.h file.
+  #endif
+
+  #if (MOTOR1_HOLD_MA > MOTOR1_RUN_MA) || (MOTOR2_HOLD_MA > MOTOR2_RUN_MA)
+    #error The HOLD current of a motor cannot exceed its RUN current.
+    #error Please review the config.h file.
+  #endif
+#endif
+
+// ISR load shedding ----------------------------------------------------------
+#ifdef USE_ISR_LOAD_SHEDDING
+  #ifndef ISR_LOAD_SHEDDING_THRESHOLD
+    #define ISR_LOAD_SHEDDING_THRESHOLD 50
+  #endif
+
+  #if (ISR_LOAD_SHEDDING_THRESHOLD < 1) || (ISR_LOAD_SHEDDING_THRESHOLD > 100)
+    #error ISR_LOAD_SHEDDING_THRESHOLD must be a percentage between 1 and 100.
+    #error Please review the config.h file.
+  #endif
+
+  #define ISR_LOAD_SHEDDING_OCRA ((TIMER0_OCRA * ISR_LOAD_SHEDDING_THRESHOLD) / 100)
+#endif
+
+// Adaptive sleep -------------------------------------------------------------
+#ifdef USE_ADAPTIVE_SLEEP
+  #ifndef ADAPTIVE_SLEEP_MIN_TIMEOUT
+    #define ADAPTIVE_SLEEP_MIN_TIMEOUT 2
+  #endif
+
+  #ifndef ADAPTIVE_SLEEP_MAX_TIMEOUT
+    #define ADAPTIVE_SLEEP_MAX_TIMEOUT 60
+  #endif
+
+  #if (ADAPTIVE_SLEEP_MIN_TIMEOUT < 1) || (ADAPTIVE_SLEEP_MAX_TIMEOUT > 255)
+    #error The adaptive sleep limits must be between 1 and 255 seconds.
+    #error Please review the config.h file.
+  #endif
+
+  #if (ADAPTIVE_SLEEP_MIN_TIMEOUT >= ADAPTIVE_SLEEP_MAX_TIMEOUT)
+    #error ADAPTIVE_SLEEP_MIN_TIMEOUT must be lower than ADAPTIVE_SLEEP_MAX_TIMEOUT.
+    #error Please review the config.h file.
+  #endif
+#endif
+
 // High resolution mode -------------------------------------------------------
 #if defined(MOTOR1_HIGH_RESOLUTION) || defined(MOTOR2_HIGH_RESOLUTION)
   #define HIGH_RESOLUTION_MODE
@@ -213,6 +456,18 @@
     #endif
 #endif
 
+#ifdef USE_DS18B20
+  #if !defined(DS18B20_PINOUT)
+    #error USE_DS18B20 is active but DS18B20_PINOUT is missing.
+    #error Please review the config.h file.
+  #endif
+
+  #ifdef DEBUG_ISR_PROFILE
+    #error USE_DS18B20 and DEBUG_ISR_PROFILE both require Timer1.
+    #error Please review the config.h file.
+  #endif
+#endif
+
 // USER INTERFACE: Keyboard ---------------------------------------------------
 #if defined(USE_UI_KAP) || defined(USE_UI_KAP_ADV)
   #if defined(UI_KAP_BUTTON_DEBOUNCE) && (UI_KAP_BUTTON_DEBOUNCE < 1 || UI_KAP_BUTTON_DEBOUNCE > 255)
@@ -223,6 +478,14 @@
     #define UI_KAP_BUTTON_DEBOUNCE 15
   #endif
 
+  // The basic keypad is interrupt driven, its debounce time is in mS
+  #if !defined(UI_KAP_DEBOUNCE_MS)
+    #define UI_KAP_DEBOUNCE_MS 20
+  #elif (UI_KAP_DEBOUNCE_MS < 1) || (UI_KAP_DEBOUNCE_MS > 1000)
+    #error UI_KAP_DEBOUNCE_MS must be between 1 and 1000.
+    #error Please review the config.h file.
+  #endif
+
   #if defined(USE_UI_KAP) && (!defined(UI_KAP_FWD_BUTTON_PIN) || !defined(UI_KAP_BWD_BUTTON_PIN))
     #error KAP configuration is not valid.
     #error Please define UI_KAP_FWD_BUTTON_PIN and UI_KAP_BWD_BUTTON_PIN
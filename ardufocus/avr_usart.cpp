@@ -19,19 +19,52 @@
 
 #include "avr_usart.h"
 
-usart::buffer_t usart::buffer;
+#ifdef USE_RS485_MULTIDROP
+  #include "io.h"
+#endif
+
+usart::buffer_t usart::buffer[USART_PORTS];
 
 ISR(USART_RX_VECT) {
   // read a byte from the incoming stream
   // check for parity error and buffer it
-  if (bit_is_clear(USART_CSRA, USART_BIT_PE)) { usart::buffer.rx.enqueue(USART_DR); }
+  if (bit_is_clear(USART_CSRA, USART_BIT_PE)) { usart::buffer[0].rx.enqueue(USART_DR); }
 }
 
 ISR(USART_TX_VECT) {
   // transmit a byte from the buffer
   // disable USART TX ISR when buffer is empty
-  if (! usart::buffer.tx.empty()) {
-    USART_DR = usart::buffer.tx.dequeue();
+  if (! usart::buffer[0].tx.empty()) {
+    USART_DR = usart::buffer[0].tx.dequeue();
     USART_CSRA |= bit(USART_BIT_TXC);
-  } else { USART_CSRB &= ~bit(USART_BIT_DRIE); }
+  } else {
+    USART_CSRB &= ~bit(USART_BIT_DRIE);
+
+    #ifdef USE_RS485_MULTIDROP
+      // the last byte is still being shifted out, only release the
+      // bus when the transmission is complete
+      USART_CSRB |= bit(USART_BIT_TXCIE);
+    #endif
+  }
+}
+
+#ifdef USE_RS485_MULTIDROP
+ISR(USART_TXC_VECT) {
+  // release the RS-485 bus unless more data was queued meanwhile
+  if (usart::buffer[0].tx.empty()) { IO::write(RS485_DE_PINOUT, LOW); }
+  USART_CSRB &= ~bit(USART_BIT_TXCIE);
+}
+#endif
+
+#ifdef USE_SERIAL_AUX
+ISR(USART_AUX_RX_VECT) {
+  if (bit_is_clear(USART_AUX_CSRA, USART_BIT_PE)) { usart::buffer[1].rx.enqueue(USART_AUX_DR); }
+}
+
+ISR(USART_AUX_TX_VECT) {
+  if (! usart::buffer[1].tx.empty()) {
+    USART_AUX_DR = usart::buffer[1].tx.dequeue();
+    USART_AUX_CSRA |= bit(USART_BIT_TXC);
+  } else { USART_AUX_CSRB &= ~bit(USART_BIT_DRIE); }
 }
+#endif
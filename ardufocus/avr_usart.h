@@ -29,13 +29,49 @@
 #define SERIAL_TXBUF_SZ 39u
 #define SERIAL_RXBUF_SZ 78u
 
+#define SERIAL_BAUDRATE 9600L
+
+#ifdef USE_SERIAL_AUX
+  #define USART_PORTS 2u
+#else
+  #define USART_PORTS 1u
+#endif
+
 namespace usart {
   struct buffer_t {
     Ringbuf<char, SERIAL_RXBUF_SZ> rx;
     Ringbuf<char, SERIAL_TXBUF_SZ> tx;
   };
 
-  extern buffer_t buffer;
+  // One set of buffers per port, indexed by the port number
+  extern buffer_t buffer[USART_PORTS];
+
+  /**
+   * @brief   USART register map
+   * @details Maps each port number into the hardware registers driving it,
+   *          port 0 is the main host link and port 1 the auxiliary port.
+   */
+  template<uint8_t N> struct regs;
+
+  template<> struct regs<0> {
+    static const uint32_t baud = SERIAL_BAUDRATE;
+    static inline volatile uint8_t& brrh() { return USART_BRRH; }
+    static inline volatile uint8_t& brrl() { return USART_BRRL; }
+    static inline volatile uint8_t& csra() { return USART_CSRA; }
+    static inline volatile uint8_t& csrb() { return USART_CSRB; }
+    static inline volatile uint8_t&   dr() { return USART_DR;   }
+  };
+
+  #ifdef USE_SERIAL_AUX
+  template<> struct regs<1> {
+    static const uint32_t baud = SERIAL_AUX_BAUDRATE;
+    static inline volatile uint8_t& brrh() { return USART_AUX_BRRH; }
+    static inline volatile uint8_t& brrl() { return USART_AUX_BRRL; }
+    static inline volatile uint8_t& csra() { return USART_AUX_CSRA; }
+    static inline volatile uint8_t& csrb() { return USART_AUX_CSRB; }
+    static inline volatile uint8_t&   dr() { return USART_AUX_DR;   }
+  };
+  #endif
 }
 
 #endif
@@ -43,6 +43,12 @@
 // where it was.
 #define USE_EEPROM
 
+// Mirrors the motor state (position, target, step mode and speed) into a CRC
+// guarded RAM area which is not cleared on reset. After a watchdog, brown-out
+// or external reset the state is restored from there, including any move
+// that was in progress, the EEPROM copy is only used after a power-on.
+//#define USE_WARM_RESTART
+
 
 // ----------------------------------------------------------------------------
 // MISCELLANEOUS --------------------------------------------------------------
@@ -59,6 +65,18 @@
 // [bug report]: https://github.com/arduino/Arduino/issues/4492
 //#define ENABLE_REMOTE_RESET
 
+// A two line banner is sent when the focuser boots, it is queued a bit at a
+// time from the main loop and dropped as soon as the first command arrives.
+// Some applications get confused by any data before the first reply, the
+// following option removes the banner entirely.
+//#define DISABLE_BOOT_BANNER
+
+// Records how long each setup phase took and when the first command was
+// served, in uS since boot. ":GU#" returns the time to the first command and
+// ":GU0#" to ":GU4#" the end of each phase (EEPROM, sensors, UI, motors and
+// ready).
+//#define DEBUG_BOOT_PROFILE
+
 // Enable a subset of commands to control the status of the DTR auto-reset
 // feature on the Arduino boards. By default Ardufocus uses a cap between the
 // reset pin and ground to prevent the DTR signal to reset the board, which
@@ -72,12 +90,96 @@
 // This is the board pin which controls the enable/disable of the feature.
 //#define DTR_RESET_PINOUT 15
 
+// The ATmega328PB has a second USART which can be used as an auxiliary port,
+// i.e. for a hand-controller link or a dedicated telemetry stream at a higher
+// rate. It speaks the same command set as the main port but has its own
+// buffers and command context, thus it never competes with the host link.
+// It uses pins 12 (RXD1) and 11 (TXD1) which must not be assigned to anything
+// else, the default motor #1 pinout must be changed when enabling this.
+//#define USE_SERIAL_AUX
+//#define SERIAL_AUX_BAUDRATE 57600
+
+// Multi-drop mode allows several focusers to share a single RS-485 bus, driven
+// by a single host link. Each unit has its own bus address, persisted on the
+// EEPROM and changed with ":SAxx#", and only processes the frames addressed to
+// it, i.e. ":@03GP#" is the ":GP#" command for the unit with address 0x03.
+// Frames sent to address 0x00 are processed by all units without a reply and
+// frames without an address are processed as usual, thus only one unit should
+// be online when using them. The transceiver driver enable pin (DE and !RE)
+// is released as soon as the last reply byte has been shifted out.
+//#define USE_RS485_MULTIDROP
+//#define RS485_DE_PINOUT 9
+//#define RS485_DEFAULT_ADDRESS 1
+
+// A chain of 74HC595 shift registers on the hardware SPI port can drive the
+// slow control lines, such as the A4988 MS1-MS3 and SLEEP or the UI LEDs,
+// freeing the direct pins for the STEP and DIR lines of more motors. All the
+// outputs are updated in a single SPI transfer. Expander outputs are numbered
+// XIO(0) (QA of the register next to the board) to XIO(8 * count - 1), i.e.
+// "#define MOTOR1_PINOUT XIO(0), XIO(1), XIO(2), XIO(3), 7, 6". The chain
+// uses pins 11 (MOSI to SER) and 13 (SCK to SRCLK) plus the latch pin (RCLK),
+// none of them can be assigned to anything else.
+//#define USE_SHIFT_REGISTER
+//#define SHIFT_REGISTER_COUNT 1
+//#define SHIFT_REGISTER_LATCH_PINOUT 10
+
+// Focus presets are kept on the EEPROM and recalled with a single command,
+// ":R3#" moves to preset 3 and ":2R3#" does the same for motor #2. A preset
+// is either an absolute position, set with ":SR3xxxx#" (or ":SR3#" to store
+// the current position), or a filter offset, set with ":SU3xxxx#" as a signed
+// value. When recalling a filter offset the focuser moves by the difference
+// to the offset of the last recalled filter, thus a filter change costs one
+// short command. ":GR3#" reads back the preset value.
+//#define USE_FOCUS_PRESETS
+//#define FOCUS_PRESETS 8
+
+// Learns how the best focus position drifts with temperature. Every time the
+// host finds the best focus it sends ":SM#" (":2SM#" for motor #2) and the
+// current position is recorded against the current temperature, the fit is
+// kept on the EEPROM across sessions. ":GM#" returns the learned slope in
+// 1/100 of a step per degree Celsius as a signed 32-bit value and ":GM1#"
+// returns the confidence (r squared, in percent) followed by the number of
+// samples. ":SM0#" forgets everything, i.e. after a mechanical change.
+//#define USE_FOCUS_LEARNING
+
+// Soft travel limits keep every move between a lower and an upper position,
+// a target outside of them is clamped thus a jog towards either end stops at
+// the limit. Near each limit there is a slow zone where the speed ramps down
+// to MOTOR*_MIN_SPEED, the middle of the travel runs at full speed and the
+// end stops are approached slowly. The limits are kept on the EEPROM and span
+// the whole counter until set: ":SZ0xxxx#" sets the lower limit, ":SZ1xxxx#"
+// the upper one and ":SZ2xxxx#" the width of the slow zones in steps (zero
+// disables them), ":GZ0#" to ":GZ2#" read them back.
+//#define USE_SOFT_LIMITS
+
 // Activating this option will enable high resolution counters (32-bit) thus
 // becoming incompatible with the standard Moonlite protocol. You should enable
 // this if using a gearbox or having a milimetric threaded rod on the drive
 // mechanism.
 //#define HIGH_RESOLUTION_MODE
 
+// ULN2003 motors keep the stepping table selected with ":SF#" or ":SH#" at any
+// speed. When active the half step mode becomes the default and, while running
+// faster than ULN2003_FULL_STEP_SPEED (in half steps/sec), the driver switches
+// by itself to the two-phase full step drive for torque and back to half steps
+// for resolution when slowing down. Positions and speeds are always counted in
+// half steps, each full step moves the counter by two and waits twice as long
+// thus the shaft speed is the same on both sides of the switch; the MAX_SPEED
+// of the motor may be raised to use the extra headroom. The switch happens only
+// on a two coil entry of the sequence so no step is ever lost.
+//#define USE_ULN2003_ADAPTIVE_DRIVE
+//#define ULN2003_FULL_STEP_SPEED 150
+
+// With two motors and a heavy acceleration profile the step ISR may exceed its
+// tick budget, when this happens the following ticks get stretched and moves
+// take longer than planned. When active the ISR will measure its own run time
+// and, when close to the budget, it will shed non-critical work: the sleep
+// counters are not updated and the last stepping speed is reused instead of
+// being recomputed. The threshold is the percentage of the tick budget which
+// triggers the shedding. Overload events can be read with the ":GO#" command.
+//#define USE_ISR_LOAD_SHEDDING
+//#define ISR_LOAD_SHEDDING_THRESHOLD 50
+
 // ----------------------------------------------------------------------------
 // MOTOR #1 CONFIGURATION -----------------------------------------------------
 // ----------------------------------------------------------------------------
@@ -85,10 +187,13 @@
 // You should only enable *ONE* of the following drivers
 // The ULN2003 shall be used with the unmodded version of 28BYJ-48 or any other
 // Unipolar stepper motor. The A4988 driver should be used with Bipolar stepper
-// motors or the modded version of the 28BYJ-48 (see the doc/ folder).
+// motors or the modded version of the 28BYJ-48 (see the doc/ folder). The
+// TMC2209 is configured over its single wire UART and offers sensorless
+// homing with the ":FH#" command.
 #define MOTOR1_USE_A4988_DRIVER
 //#define MOTOR1_USE_DRV8825_DRIVER
 //#define MOTOR1_USE_ULN2003_DRIVER
+//#define MOTOR1_USE_TMC2209_DRIVER
 
 // Driver pin-out definition
 // Define bellow the pin-out for your specific driver.
@@ -97,11 +202,33 @@
   #define MOTOR1_PINOUT   2,   3,   4,   5
 #endif
 
-#ifdef MOTOR1_USE_A4988_DRIVER
+#if defined(MOTOR1_USE_A4988_DRIVER) || defined(MOTOR1_USE_DRV8825_DRIVER)
   //                    MS1, MS2, MS3, SLEEP,  STEP, DIR
   #define MOTOR1_PINOUT  12,  11,  10,     8,     7,   6
 #endif
 
+#ifdef MOTOR1_USE_TMC2209_DRIVER
+  //                    ENA, STEP, DIR, UART, DIAG
+  #define MOTOR1_PINOUT   8,    7,   6,   12,   11
+
+  // The UART address is set by the MS1 and MS2 pins, the current is the RMS
+  // run current in mA and the microsteps are interpolated to 1/256. A stall
+  // threshold other than 0 enables StallGuard: moves stop when the motor
+  // stalls and ":FH#" homes the motor against the inner end of travel. Higher
+  // values make the detection more sensitive. Stalls are only detected above
+  // TMC2209_STALL_MIN_SPEED (steps/sec), the load reading is meaningless when
+  // slower, thus the homing speed must be above it. ":GF#" returns the number
+  // of stalls since boot. The sense resistor value of your board (mR), the
+  // UART speed and the stall speed are shared by both motors.
+  #define MOTOR1_TMC2209_ADDRESS          0
+  #define MOTOR1_TMC2209_CURRENT        500
+  #define MOTOR1_TMC2209_MICROSTEPS      16
+  #define MOTOR1_TMC2209_STALL_THRESHOLD  0
+  //#define TMC2209_RSENSE 110
+  //#define TMC2209_UART_BAUD 57600
+  //#define TMC2209_STALL_MIN_SPEED 100
+#endif
+
 // Activate the following directive if you'd like to invert the motor rotation
 // changing the focus direction.
 //#define MOTOR1_INVERT_DIRECTION
@@ -128,6 +255,7 @@
 #define MOTOR2_USE_A4988_DRIVER
 //#define MOTOR2_USE_DRV8825_DRIVER
 //#define MOTOR2_USE_ULN2003_DRIVER
+//#define MOTOR2_USE_TMC2209_DRIVER
 
 // Driver pin-out definition
 // Define bellow the pin-out for your specific driver.
@@ -136,16 +264,60 @@
   #define MOTOR2_PINOUT   2,   3,   4,   5
 #endif
 
-#ifdef MOTOR2_USE_A4988_DRIVER
+#if defined(MOTOR2_USE_A4988_DRIVER) || defined(MOTOR2_USE_DRV8825_DRIVER)
   //                    MS1, MS2, MS3, SLEEP,  STEP, DIR
   #define MOTOR2_PINOUT  18,  17,  16,    15,    14,  13
 #endif
 
+#ifdef MOTOR2_USE_TMC2209_DRIVER
+  //                    ENA, STEP, DIR, UART, DIAG
+  #define MOTOR2_PINOUT  15,   14,  13,   18,   17
+
+  #define MOTOR2_TMC2209_ADDRESS          1
+  #define MOTOR2_TMC2209_CURRENT        500
+  #define MOTOR2_TMC2209_MICROSTEPS      16
+  #define MOTOR2_TMC2209_STALL_THRESHOLD  0
+#endif
+
 //#define MOTOR2_INVERT_DIRECTION
 
 #define MOTOR2_SLEEP_WHEN_IDLE
 #define MOTOR2_SLEEP_TIMEOUT 15
 
+// ----------------------------------------------------------------------------
+// POWER MANAGEMENT -----------------------------------------------------------
+// ----------------------------------------------------------------------------
+// When powering the focuser from a weak supply, such as a field battery pack,
+// driving both motors at full current at the same time may brown out the
+// board. When active the motors share a current budget: both motors move at
+// the same time when their run currents fit in it, otherwise the moves are
+// serialized. A move already running is never paused, stopping a motor at
+// speed without a ramp loses steps, thus the shortest move only goes first
+// when both start together (e.g. both resumed after a warm restart). The
+// holding current of an idle or waiting motor is cut only when it does not
+// fit next to the moving one. POWER_BUDGET_MA is the supply current available
+// to the motors, the RUN value is the draw of a motor while stepping and the
+// HOLD value while it is powered but idle (all in mA).
+//#define USE_POWER_BUDGET
+
+#ifdef USE_POWER_BUDGET
+  #define POWER_BUDGET_MA 1000
+  #define MOTOR1_RUN_MA    600
+  #define MOTOR1_HOLD_MA   300
+  #define MOTOR2_RUN_MA    600
+  #define MOTOR2_HOLD_MA   300
+#endif
+
+// When active the sleep timeout of each motor will adapt itself to the interval
+// between consecutive moves: the motor will be kept powered during dense move
+// sequences, such as an AF run, and will go to sleep early when the moves are
+// far apart, such as during long exposures. The *_SLEEP_TIMEOUT value is used
+// as the starting point and the learned value (in seconds) is bounded by the
+// limits bellow. Requires *_SLEEP_WHEN_IDLE to be active.
+//#define USE_ADAPTIVE_SLEEP
+//#define ADAPTIVE_SLEEP_MIN_TIMEOUT 2
+//#define ADAPTIVE_SLEEP_MAX_TIMEOUT 60
+
 // ----------------------------------------------------------------------------
 // SPEED PROFILE --------------------------------------------------------------
 // ----------------------------------------------------------------------------
@@ -234,6 +406,18 @@
 // the temperature gathering process on every temperature read command.
 #define START_TEMP_CONVERSION_ON_EVERY_GET
 
+// Use DS18B20 digital sensors on a 1-Wire bus instead of the NTC, the bus
+// requires a 4.7K pull-up resistor and the sensors must be externally powered
+// as parasite power is not supported. The bus is driven by Timer1 thus this
+// cannot be used together with DEBUG_ISR_PROFILE.
+//#define USE_DS18B20
+//#define DS18B20_PINOUT 9
+
+// When more than one sensor shares the bus list their ROM codes here, ":GT#"
+// reports the first one and ":GT1#" up to ":GT9#" the others. Leave it
+// undefined for a single sensor.
+//#define DS18B20_ROMS { 0x28, 0xFF, 0x4C, 0x60, 0x91, 0x16, 0x04, 0x2E }, { 0x28, 0xFF, 0x0A, 0x3B, 0x90, 0x16, 0x05, 0x71 }
+
 
 // ----------------------------------------------------------------------------
 // USER INTERFACE -------------------------------------------------------------
@@ -268,6 +452,10 @@
 // If you decide to use any other wiring logic comment out the following line
 #define UI_KAP_INVERT_BUTTON_LOGIC
 
+// The buttons are read by pin change interrupts, a press or release is only
+// accepted after the contact has been stable for this long (mS).
+//#define UI_KAP_DEBOUNCE_MS 20
+
 #endif 
 
 //////////////////////////
@@ -0,0 +1,267 @@
+/**
+ * Ardufocus - Moonlite compatible focuser
+ * Copyright (C) 2017-2019 João Brázio [joao@brazio.org]
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "ds18b20.h"
+
+#ifdef USE_DS18B20
+
+#include <string.h>
+#include <avr/pgmspace.h>
+#include <util/crc16.h>
+#include <util/delay.h>
+
+// Timer1 runs at F_CPU/8
+#define DS18B20_TICKS(us) ((us) * (F_CPU / 8000000L))
+
+// Recovery time between bit slots, long enough to let the step ISR run
+#define DS18B20_SLOT_GAP 200
+
+#define DS18B20_SKIP_ROM       0xCC
+#define DS18B20_MATCH_ROM      0x55
+#define DS18B20_CONVERT_T      0x44
+#define DS18B20_READ_SCRATCH   0xBE
+
+#ifdef DS18B20_ROMS
+  static const uint8_t s_roms[][8] PROGMEM = { DS18B20_ROMS };
+  #define DS18B20_SENSORS asizeof(s_roms)
+#else
+  #define DS18B20_SENSORS 1
+#endif
+
+static volatile int16_t s_cache[DS18B20_SENSORS];
+
+/**
+ * @brief Static class member initialization
+ */
+volatile DS18B20::state_t DS18B20::s_state = DS18B20::STATE_IDLE;
+volatile bool    DS18B20::s_present = false;
+volatile uint8_t DS18B20::s_bit = 0;
+
+uint8_t DS18B20::s_tx[10] = { 0 };
+uint8_t DS18B20::s_tx_len = 0;
+uint8_t DS18B20::s_rx[9] = { 0 };
+uint8_t DS18B20::s_rx_len = 0;
+
+volatile uint8_t* DS18B20::s_ddr = NULL;
+volatile uint8_t* DS18B20::s_pin = NULL;
+uint8_t DS18B20::s_mask = 0;
+
+/**
+ * @brief Timer1 interrupt handler
+ */
+ISR(TIMER1_COMPA_vect)
+{
+  DS18B20::isr();
+}
+
+/**
+ * @brief Configure the bus pin and Timer1
+ * @details The pin is never driven high, it is either pulled low or released
+ *          to the external pull-up by switching its direction.
+ *
+ */
+void DS18B20::setup()
+{
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    s_mask = hal_tbl_lookup(DS18B20_PINOUT, IO_BIT);
+    s_ddr  = (volatile uint8_t *)(hal_tbl_lookup(DS18B20_PINOUT, IO_DIR));
+    s_pin  = (volatile uint8_t *)(hal_tbl_lookup(DS18B20_PINOUT, IO_IN));
+
+    volatile uint8_t *port = (volatile uint8_t *)(hal_tbl_lookup(DS18B20_PINOUT, IO_DATA));
+    *port  &= ~s_mask;
+    *s_ddr &= ~s_mask;
+
+    for(uint8_t i = 0; i < DS18B20_SENSORS; i++) { s_cache[i] = DS18B20_INVALID; }
+
+    // Cleanup all the relevant registers
+    TCCR1A = 0; TCCR1B = 0; TIMSK1 = 0;
+    TIFR1  = 0; TCNT1  = 0;
+
+    // set waveform generation mode to CTC, top OCR1A, clock select to clk/8
+    TCCR1B |= bit(WGM12) | bit(CS11);
+  }
+}
+
+uint8_t DS18B20::count()
+{
+  return DS18B20_SENSORS;
+}
+
+/**
+ * @brief   Last valid reading of a sensor
+ * @details In 1/16 of a degree Celsius, DS18B20_INVALID when the sensor
+ *          does not exist or did not answer.
+ *
+ */
+int16_t DS18B20::read(const uint8_t& sensor)
+{
+  if(sensor >= DS18B20_SENSORS) { return DS18B20_INVALID; }
+
+  int16_t t;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) { t = s_cache[sensor]; }
+  return t;
+}
+
+/**
+ * @brief Start a bus transaction
+ * @details With reset the sensor is addressed and cmd is sent before reading
+ *          rx_len bytes, without it only the read slots are issued.
+ *
+ */
+void DS18B20::start(const bool& reset, const uint8_t& sensor, const uint8_t& cmd, const uint8_t& rx_len)
+{
+  s_tx_len = 0;
+
+  if(reset) {
+    #ifdef DS18B20_ROMS
+    if(sensor < DS18B20_SENSORS) {
+      s_tx[s_tx_len++] = DS18B20_MATCH_ROM;
+      memcpy_P(&s_tx[s_tx_len], s_roms[sensor], 8);
+      s_tx_len += 8;
+    }
+    else
+    #else
+    (void) sensor;
+    #endif
+    s_tx[s_tx_len++] = DS18B20_SKIP_ROM;
+    s_tx[s_tx_len++] = cmd;
+  }
+
+  s_rx_len = rx_len;
+  memset(s_rx, 0, sizeof(s_rx));
+
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    s_bit     = 0;
+    s_present = true;
+    s_state   = (reset) ? STATE_RESET : STATE_SLOT;
+
+    TCNT1  = 0;
+    OCR1A  = DS18B20_TICKS(10);
+    TIFR1  = bit(OCF1A);
+    TIMSK1 |= bit(OCIE1A);
+  }
+}
+
+/**
+ * @brief Bus state machine, called on every Timer1 compare match
+ *
+ */
+void DS18B20::isr()
+{
+  uint16_t next = DS18B20_SLOT_GAP;
+
+  switch(s_state) {
+    case STATE_RESET:
+      *s_ddr |= s_mask;
+      next = 480;
+      s_state = STATE_PRESENCE;
+      break;
+
+    case STATE_PRESENCE:
+      *s_ddr &= ~s_mask;
+      _delay_us(70);
+      s_present = !(*s_pin & s_mask);
+      next = 410;
+      s_state = (s_present) ? STATE_SLOT : STATE_IDLE;
+      break;
+
+    case STATE_SLOT: {
+      const uint8_t n = s_bit++;
+
+      if(n < (s_tx_len << 3)) {
+        // write slot, a one is a short low pulse and a zero a long one
+        const bool one = s_tx[n >> 3] & bit(n & 7);
+        *s_ddr |= s_mask;
+        if(one) { _delay_us(5); } else { _delay_us(60); }
+        *s_ddr &= ~s_mask;
+      }
+
+      else if(n < ((s_tx_len + s_rx_len) << 3)) {
+        // read slot, the sensor holds the line low for a zero
+        const uint8_t m = n - (s_tx_len << 3);
+        *s_ddr |= s_mask;
+        _delay_us(2);
+        *s_ddr &= ~s_mask;
+        _delay_us(8);
+        if(*s_pin & s_mask) { s_rx[m >> 3] |= bit(m & 7); }
+      }
+
+      else { s_state = STATE_IDLE; }
+      break;
+    }
+
+    default:
+      s_state = STATE_IDLE;
+  }
+
+  if(s_state == STATE_IDLE) { TIMSK1 &= ~bit(OCIE1A); }
+  else {
+    TCNT1 = 0;
+    OCR1A = DS18B20_TICKS(next);
+  }
+}
+
+/**
+ * @brief Conversion scheduler, called from the Timer2 ISR
+ * @details Each call collects the previous transaction and starts the next
+ *          one: convert all, poll until the conversion is done, then read
+ *          each sensor in turn. A transaction takes ~40mS thus it is always
+ *          done by the next call.
+ *
+ */
+void DS18B20::tick()
+{
+  static enum { PHASE_CONVERT, PHASE_POLL, PHASE_READ } phase = PHASE_CONVERT;
+  static uint8_t sensor = 0;
+
+  if(s_state != STATE_IDLE) { return; }
+
+  switch(phase) {
+    case PHASE_POLL:
+      // the sensors answer with zeros until the conversion is done
+      if(s_present && s_rx[0] == 0) { start(false, 0, 0, 1); return; }
+
+      sensor = 0;
+      phase  = PHASE_READ;
+      start(true, sensor, DS18B20_READ_SCRATCH, sizeof(s_rx));
+      return;
+
+    case PHASE_READ: {
+      uint8_t crc = 0;
+      for(uint8_t i = 0; i < sizeof(s_rx); i++) { crc = _crc_ibutton_update(crc, s_rx[i]); }
+
+      // an all zeros scratchpad has a valid CRC, the config byte never is zero
+      s_cache[sensor] = (s_present && crc == 0 && s_rx[4] != 0)
+        ? (int16_t) (s_rx[0] | (s_rx[1] << 8)) : DS18B20_INVALID;
+
+      if(++sensor < DS18B20_SENSORS) {
+        start(true, sensor, DS18B20_READ_SCRATCH, sizeof(s_rx));
+        return;
+      }
+    }
+    // fall through
+
+    case PHASE_CONVERT:
+      // address everybody at once
+      start(true, 0xFF, DS18B20_CONVERT_T, 0);
+      phase = PHASE_POLL;
+  }
+}
+
+#endif
@@ -0,0 +1,89 @@
+/**
+ * Ardufocus - Moonlite compatible focuser
+ * Copyright (C) 2017-2019 João Brázio [joao@brazio.org]
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __DS18B20_H__
+#define __DS18B20_H__
+
+#include "config.h"
+
+#include <stdint.h>
+#include <avr/interrupt.h>
+#include <avr/io.h>
+#include <util/atomic.h>
+#include "hal.h"
+#include "macro.h"
+
+#ifdef USE_DS18B20
+
+#define DS18B20_INVALID INT16_MIN
+
+/**
+ * @brief   DS18B20 1-Wire temperature sensor
+ * @details The bus is driven by a Timer1 state machine: every reset phase and
+ *          bit slot is one compare match, the short intra-slot timings are
+ *          done inside the ISR (70uS at most) and nothing ever waits in the
+ *          main loop. Conversions are started for all sensors at once and
+ *          polled from the Timer2 scheduler until they are done, then each
+ *          scratchpad is read and CRC checked into a cache.
+ *
+ *          Without DS18B20_ROMS a single sensor is addressed with Skip ROM.
+ */
+class DS18B20
+{
+  /**
+   * Disable the creation of an instance of this object.
+   * This class should be used as a static class.
+   */
+  private:
+     DS18B20() {;}
+    ~DS18B20() {;}
+
+    enum state_t {
+      STATE_IDLE,
+      STATE_RESET,
+      STATE_PRESENCE,
+      STATE_SLOT
+    };
+
+    static volatile state_t s_state;
+    static volatile bool    s_present;
+    static volatile uint8_t s_bit;
+
+    static uint8_t s_tx[10];
+    static uint8_t s_tx_len;
+    static uint8_t s_rx[9];
+    static uint8_t s_rx_len;
+
+    static volatile uint8_t* s_ddr;
+    static volatile uint8_t* s_pin;
+    static uint8_t s_mask;
+
+    static void start(const bool& reset, const uint8_t& sensor, const uint8_t& cmd, const uint8_t& rx_len);
+
+  public:
+    static void setup();
+    static void tick();
+    static void isr();
+
+    static uint8_t count();
+    static int16_t read(const uint8_t& sensor);
+};
+
+#endif
+#endif
@@ -19,7 +19,15 @@
 
 #include "eeprom.h"
 
+#include <avr/io.h>
+#include <util/atomic.h>
+
 #ifdef USE_EEPROM
+  volatile bool g_config_dirty = false;
+
+  // Number of saves since boot, used to compare the EEPROM wear of sessions
+  static volatile uint16_t s_save_count = 0;
+
   void eeprom_init(eeprom_map_t * ptr)
   {
     eeprom_busy_wait();
@@ -41,5 +49,31 @@
   void eeprom_save(eeprom_map_t * ptr)
   {
     eeprom_update_block(ptr, EEPROM_START_ADDRESS, sizeof(eeprom_map_t));
+    if(s_save_count < UINT16_MAX) { ++s_save_count; }
+  }
+
+  /**
+   * @brief   Write a deferred save, the only EEPROM writer after boot
+   * @details The step ISR is masked meanwhile, it updates the motor positions
+   *          on the map and a half copied value would be written otherwise.
+   */
+  void eeprom_flush(eeprom_map_t * ptr)
+  {
+    if(! g_config_dirty) { return; }
+
+    const uint8_t timsk = TIMSK0;
+    TIMSK0 = timsk & ~bit(OCIE0A);
+
+    g_config_dirty = false;
+    eeprom_save(ptr);
+
+    TIMSK0 = timsk;
+  }
+
+  uint16_t eeprom_save_count()
+  {
+    uint16_t n;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) { n = s_save_count; }
+    return n;
   }
 #endif
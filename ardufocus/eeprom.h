@@ -27,27 +27,76 @@
 #include <avr/eeprom.h>
 #include <avr/pgmspace.h>
 #include "macro.h"
+#include "tempfit.h"
 
 #define EEPROM_MAGIC_HEADER  0xaa55
 #define EEPROM_START_ADDRESS 0x0000
 
+#define PRESET_MAGIC_HEADER  0xa5
+#define TEMPFIT_MAGIC_HEADER 0x5a
+#define LIMITS_MAGIC_HEADER  0x3c
+
+enum preset_kind_t {
+  PRESET_UNSET,
+  PRESET_POSITION,  // Absolute focus position
+  PRESET_OFFSET     // Filter offset, applied relative to the active one
+};
+
+struct preset_t {
+  uint8_t  kind;
+  uint32_t value;
+};
+
+struct limits_t {
+  uint32_t lower;
+  uint32_t upper;
+  uint32_t zone;    // Slow zone width, in steps
+};
+
 struct eeprom_map_t {
   uint16_t header;      // 00
   uint32_t position_m1; // 02
   uint32_t position_m2; // 06
   bool     dtr_reset;   // 10
+  uint8_t  bus_address; // 11
+
+  #ifdef USE_FOCUS_PRESETS
+  uint8_t  preset_header;              // 12
+  int32_t  preset_offset[2];           // 13, active filter offset per motor
+  preset_t preset[2][FOCUS_PRESETS];   // 21
+  #endif
+
+  #ifdef USE_FOCUS_LEARNING
+  uint8_t   tempfit_header;
+  tempfit_t tempfit[2];                // per motor
+  #endif
+
+  #ifdef USE_SOFT_LIMITS
+  uint8_t  limits_header;
+  limits_t limits[2];                  // per motor
+  #endif
 };
 
 extern eeprom_map_t g_config;
 
 #ifdef USE_EEPROM
+  // Set when g_config changed, eeprom_flush() writes it from the main loop
+  extern volatile bool g_config_dirty;
+
   void eeprom_init(eeprom_map_t *);
   void eeprom_load(eeprom_map_t *);
   void eeprom_save(eeprom_map_t *);
+  void eeprom_flush(eeprom_map_t *);
+  uint16_t eeprom_save_count();
+
+  inline void eeprom_defer_save() { g_config_dirty = true; }
 #else
   inline void eeprom_init(eeprom_map_t * ptr) { memset(ptr, 0, sizeof(eeprom_map_t)); }
   inline void eeprom_load(eeprom_map_t *) { ; }
   inline void eeprom_save(eeprom_map_t *) { ; }
+  inline void eeprom_flush(eeprom_map_t *) { ; }
+  inline uint16_t eeprom_save_count() { return 0; }
+  inline void eeprom_defer_save() { ; }
 #endif
 
 #endif
@@ -67,16 +67,32 @@ enum hal_register_headers_t { IO_DIR, IO_DATA, IO_IN, IO_BIT };
   #define USART_BIT_RXCIE RXCIE0 // Receive Complete Interrupt Enable
   #define USART_BIT_RXEN  RXEN0  // Receive Enable
   #define USART_BIT_TXC   TXC0   // Transmit Complete
+  #define USART_BIT_TXCIE TXCIE0 // Transmit Complete Interrupt Enable
   #define USART_BIT_TXEN  TXEN0  // Transmit Enable
   #define USART_BIT_U2X   U2X0   // Double Speed Operation
 
   #ifdef __AVR_ATmega328PB__
     #define USART_RX_VECT USART0_RX_vect
     #define USART_TX_VECT USART0_UDRE_vect
+    #define USART_TXC_VECT USART0_TX_vect
+
+    // The 328PB has a second USART which is used as the auxiliary port,
+    // the register bit positions are the same as for the first one.
+    #define HAS_USART_AUX
+
+    #define USART_AUX_BRRH UBRR1H
+    #define USART_AUX_BRRL UBRR1L
+    #define USART_AUX_CSRA UCSR1A
+    #define USART_AUX_CSRB UCSR1B
+    #define USART_AUX_DR   UDR1
+
+    #define USART_AUX_RX_VECT USART1_RX_vect
+    #define USART_AUX_TX_VECT USART1_UDRE_vect
 
   #else
     #define USART_RX_VECT USART_RX_vect
     #define USART_TX_VECT USART_UDRE_vect
+    #define USART_TXC_VECT USART_TX_vect
   #endif
 
 #elif defined(__AVR_ATmega16U4__) || defined(__AVR_ATmega32U4__)
@@ -124,11 +140,13 @@ enum hal_register_headers_t { IO_DIR, IO_DATA, IO_IN, IO_BIT };
   #define USART_BIT_RXCIE RXCIE1 // Receive Complete Interrupt Enable
   #define USART_BIT_RXEN  RXEN1  // Receive Enable
   #define USART_BIT_TXC   TXC1   // Transmit Complete
+  #define USART_BIT_TXCIE TXCIE1 // Transmit Complete Interrupt Enable
   #define USART_BIT_TXEN  TXEN1  // Transmit Enable
   #define USART_BIT_U2X   U2X1   // Double Speed Operation
 
   #define USART_RX_VECT USART1_RX_vect
   #define USART_TX_VECT USART1_UDRE_vect
+  #define USART_TXC_VECT USART1_TX_vect
 
 #else
   const uint16_t pin_map[][0] PROGMEM = {{}};
@@ -26,6 +26,7 @@
 #include <util/atomic.h>
 #include <avr/pgmspace.h>
 #include "hal.h"
+#include "shiftreg.h"
 
 typedef uint8_t pin_t;
 
@@ -40,7 +41,12 @@ class IO
     ~IO() {;}
 
   public:
+    // Expander outputs are always outputs, direction changes are ignored
     static inline void set_as_input(const uint8_t &pin) {
+      #ifdef USE_SHIFT_REGISTER
+      if(pin >= XIO_PIN_BASE) { return; }
+      #endif
+
       const uint8_t     mask = hal_tbl_lookup(pin, IO_BIT);
       volatile uint8_t *mode = (volatile uint8_t *)(hal_tbl_lookup(pin, IO_DIR));
       volatile uint8_t *port = (volatile uint8_t *)(hal_tbl_lookup(pin, IO_DATA));
@@ -52,6 +58,10 @@ class IO
     }
 
     static inline void set_as_output(const uint8_t &pin) {
+      #ifdef USE_SHIFT_REGISTER
+      if(pin >= XIO_PIN_BASE) { return; }
+      #endif
+
       const uint8_t     mask = hal_tbl_lookup(pin, IO_BIT);
       volatile uint8_t *mode = (volatile uint8_t *)(hal_tbl_lookup(pin, IO_DIR));
 
@@ -61,6 +71,10 @@ class IO
     }
 
     static inline void write(const uint8_t &pin, const uint8_t &value) {
+      #ifdef USE_SHIFT_REGISTER
+      if(pin >= XIO_PIN_BASE) { ShiftReg::write(pin - XIO_PIN_BASE, value != LOW); return; }
+      #endif
+
       const uint8_t     mask = hal_tbl_lookup(pin, IO_BIT);
       volatile uint8_t *port = (volatile uint8_t *)(hal_tbl_lookup(pin, IO_DATA));
 
@@ -71,12 +85,33 @@ class IO
     }
 
     static inline uint8_t read(const uint8_t &pin) {
+        #ifdef USE_SHIFT_REGISTER
+        if(pin >= XIO_PIN_BASE) { return ShiftReg::read(pin - XIO_PIN_BASE) ? HIGH : LOW; }
+        #endif
+
         const uint8_t     mask  = hal_tbl_lookup(pin, IO_BIT);
         volatile uint8_t *port  = (volatile uint8_t *)(hal_tbl_lookup(pin, IO_IN));
 
         if (*port & mask) return HIGH;
         return LOW;
     }
+
+    /**
+     * @brief   Group several writes into a single update
+     * @details Only expander outputs are deferred until batch_end(), direct
+     *          pins are still written immediately.
+     */
+    static inline void batch_begin() {
+      #ifdef USE_SHIFT_REGISTER
+      ShiftReg::hold();
+      #endif
+    }
+
+    static inline void batch_end() {
+      #ifdef USE_SHIFT_REGISTER
+      ShiftReg::release();
+      #endif
+    }
 };
 
 #endif
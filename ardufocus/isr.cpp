@@ -19,6 +19,80 @@
 
 #include "isr.h"
 
+volatile uint32_t g_uptime_ms = 0;
+uint32_t g_clock_offset = 0;
+volatile bool g_isr_tasks = false;
+
+#ifdef USE_ISR_LOAD_SHEDDING
+volatile uint16_t g_isr_overloads = 0;
+#endif
+
+#ifdef USE_POWER_BUDGET
+  /**
+   * @brief Steps left on the move of a motor
+   *
+   */
+  static inline uint32_t remaining(stepper* const m)
+  {
+    const uint32_t current = m->get_current_position();
+    const uint32_t target  = m->get_target_position();
+    return (target > current) ? target - current : current - target;
+  }
+
+  /**
+   * @brief Share the power budget between the motors
+   * @details
+   * Called on every step tick, returns the motor allowed to step or 0 when
+   * both may. When both motors move and their run currents do not fit in
+   * POWER_BUDGET_MA the moves are serialized: a move already running keeps
+   * the budget until it is complete, when both start together the one which
+   * will be over first at its max speed goes first. Whatever the order the
+   * last move ends at the same time, going shortest first brings the first
+   * one in earlier. The holding current of the other motor is only cut when
+   * it does not fit next to the run current of the moving one, its next step
+   * powers it up again.
+   *
+   */
+  static inline uint8_t power_budget()
+  {
+    static uint8_t owner = 0;
+    static bool powered1 = true, powered2 = true;
+
+    const bool moving1 = g_motor1->is_moving();
+    const bool moving2 = g_motor2->is_moving();
+
+    // An idle motor past its sleep timeout has cut its own current
+    if(! moving1 && g_motor1->get_sleep_when_idle() && ! g_motor1->is_active()) { powered1 = false; }
+    if(! moving2 && g_motor2->get_sleep_when_idle() && ! g_motor2->is_active()) { powered2 = false; }
+
+    if(moving1 && moving2) {
+      if(MOTOR1_RUN_MA + MOTOR2_RUN_MA <= POWER_BUDGET_MA) { owner = 0; }
+      else if(! owner) {
+        owner = ((uint64_t) remaining(g_motor1) * g_motor2->get_max_speed()
+              <= (uint64_t) remaining(g_motor2) * g_motor1->get_max_speed()) ? 1 : 2;
+      }
+    }
+    else if(moving1) { owner = 1; }
+    else if(moving2) { owner = 2; }
+    else { owner = 0; }
+
+    if(owner == 1 && powered2 && (MOTOR1_RUN_MA + MOTOR2_HOLD_MA > POWER_BUDGET_MA)) {
+      g_motor2->power_down();
+      powered2 = false;
+    }
+
+    if(owner == 2 && powered1 && (MOTOR2_RUN_MA + MOTOR1_HOLD_MA > POWER_BUDGET_MA)) {
+      g_motor1->power_down();
+      powered1 = false;
+    }
+
+    if(moving1 && owner != 2) { powered1 = true; }
+    if(moving2 && owner != 1) { powered2 = true; }
+
+    return owner;
+  }
+#endif
+
 /**
  * @brief Timer0 interrupt handler - Movements of Focuser
  * @details  
@@ -31,10 +105,26 @@
  */
 ISR(TIMER0_COMPA_vect)
 {
+  #ifdef DEBUG_ISR_PROFILE
+    const uint16_t start = profile_now();
+  #endif
+
   #ifdef DEBUG_ISR
     PORTB ^= bit(PB5);
   #endif
 
+  #ifdef USE_ISR_LOAD_SHEDDING
+    // When the previous tick overran its budget start shedding right away
+    static bool overloaded = false;
+    bool shed = overloaded;
+  #else
+    const bool shed = false;
+  #endif
+
+  #ifdef USE_POWER_BUDGET
+    const uint8_t owner = power_budget();
+  #endif
+
   #ifdef MOTOR1_HAS_DRIVER
     #ifdef DEBUG_ISR
       PORTC ^= bit(PC2);
@@ -44,7 +134,10 @@ ISR(TIMER0_COMPA_vect)
     // This block takes ~50uS to execute when motor is stepping
     //
 
-    g_motor1->tick();
+    #ifdef USE_POWER_BUDGET
+    if(owner != 2)
+    #endif
+    g_motor1->tick(shed);
 
     // previous motor state
     static bool pstate1 = g_motor1->is_moving();
@@ -55,7 +148,7 @@ ISR(TIMER0_COMPA_vect)
     if(cstate1 != pstate1) {
       if(cstate1 == false) {
         g_config.position_m1 = g_motor1->get_current_position();
-        eeprom_save(&g_config);
+        eeprom_defer_save();
       }
       pstate1 = cstate1;
     }
@@ -70,11 +163,20 @@ ISR(TIMER0_COMPA_vect)
       PORTC ^= bit(PC3);
     #endif
 
+    #ifdef USE_ISR_LOAD_SHEDDING
+      // Timer0 counts up to TIMER0_OCRA thus its value tells how much of the
+      // tick budget has been used so far by the first motor.
+      shed = shed || (TCNT0 >= ISR_LOAD_SHEDDING_OCRA) || bit_is_set(TIFR0, OCF0A);
+    #endif
+
     //
     // This block takes ~50uS to execute when motor is stepping
     //
     //
-    g_motor2->tick();
+    #ifdef USE_POWER_BUDGET
+    if(owner != 1)
+    #endif
+    g_motor2->tick(shed);
 
     // previous motor state
     static bool pstate2 = g_motor2->is_moving();
@@ -85,7 +187,7 @@ ISR(TIMER0_COMPA_vect)
     if(cstate2 != pstate2) {
       if(cstate2 == false) {
         g_config.position_m2 = g_motor2->get_current_position();
-        eeprom_save(&g_config);
+        eeprom_defer_save();
       }
       pstate2 = cstate2;
     }
@@ -95,25 +197,83 @@ ISR(TIMER0_COMPA_vect)
     #endif
   #endif
 
+  #ifdef USE_ISR_LOAD_SHEDDING
+    overloaded = (TCNT0 >= ISR_LOAD_SHEDDING_OCRA) || bit_is_set(TIFR0, OCF0A);
+    if(overloaded && g_isr_overloads < UINT16_MAX) { ++g_isr_overloads; }
+  #endif
+
+  //
+  // Stop the clock when there is nothing left to do, neither moving nor
+  // counting down to sleep, until the next move re-arms it.
+  //
+  bool active = false;
+
+  #ifdef MOTOR1_HAS_DRIVER
+    active = active || g_motor1->is_active();
+  #endif
+
+  #ifdef MOTOR2_HAS_DRIVER
+    active = active || g_motor2->is_active();
+  #endif
+
+  if(! active) {
+    TCCR0B &= ~TIMER0_CS;
+
+    #ifdef USE_ISR_LOAD_SHEDDING
+      overloaded = false;
+    #endif
+  }
+
   #ifdef DEBUG_ISR
     PORTB ^= bit(PB5);
   #endif
+
+  #ifdef DEBUG_ISR_PROFILE
+    profile_isr(start);
+  #endif
 }
 
 /**
  * @brief Timer2 interrupt handler
- * @details
+ * @details Keeps the millisecond uptime clock and runs the background tasks
+ *          (temperature and keypad ADC reads) on every TIMER2_TASK_DIV tick.
  *
  */
 ISR(TIMER2_COMPA_vect)
 {
+  ++g_uptime_ms;
+
+  #ifdef DEBUG_ISR_PROFILE
+    // Main loop iterations during the last second, Timer0 is not used as it
+    // is stopped while the motors are idle
+    static uint16_t ticks = 0;
+    static uint32_t loops = 0;
+
+    if(++ticks >= TIMER2_FREQ) {
+      g_profile.loop_rate = g_profile.loop_cnt - loops;
+      loops = g_profile.loop_cnt;
+      ticks = 0;
+    }
+  #endif
+
+  // The clock starts early during boot, the tasks only when setup is done
+  static uint8_t prescaler = 0;
+  if(! g_isr_tasks || ++prescaler < TIMER2_TASK_DIV) { return; }
+  prescaler = 0;
+
   static uint8_t counter = 0;
 
   switch(counter++)
   {
+    #ifdef USE_DS18B20
+    case 0:
+      DS18B20::tick();
+      break;
+    #else
     case NTC_ADC_CHANNEL + 10:
       Analog::read_async(NTC_ADC_CHANNEL);
       break;
+    #endif
 
     #ifdef USE_UI_KAP_ADV
     case UI_KAP_ADC_CHANNEL + 30:
@@ -23,11 +23,37 @@
 #include "config.h"
 
 #include <avr/interrupt.h>
+#include <util/atomic.h>
 #include "stepper.h"
 #include "eeprom.h"
 #include "analog.h"
+#include "ds18b20.h"
+#include "profile.h"
+#include "uptime.h"
 #include "macro.h"
 
+#ifdef USE_ISR_LOAD_SHEDDING
+extern volatile uint16_t g_isr_overloads;
+#endif
+
+// Set once the modules used by the Timer2 background tasks are ready
+extern volatile bool g_isr_tasks;
+
+/**
+ * @brief   Restart the step timer if it was stopped
+ * @details Timer0 is stopped by its own ISR once all motors are idle, the
+ *          next tick happens one full period after the call.
+ */
+inline void timer0_wake() {
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    if(TCCR0B & TIMER0_CS) { return; }
+
+    TCNT0 = 0;
+    TIFR0 = bit(OCF0A);
+    TCCR0B |= TIMER0_CS;
+  }
+}
+
 #ifdef MOTOR1_HAS_DRIVER
 extern stepper* g_motor1;
 #endif
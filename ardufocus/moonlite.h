@@ -22,67 +22,176 @@
 
 #define CMD_START_CHAR  0x3A // :
 #define CMD_END_CHAR    0x23 // #
-#define CMD_MAX_LEN      13u
+#define CMD_ADDR_CHAR   0x40 // @
 
 #include "config.h"
 
+#ifdef USE_RS485_MULTIDROP
+  #define CMD_MAX_LEN    16u
+#else
+  #define CMD_MAX_LEN    13u
+#endif
+
+// Longest reply, a position sample
+#define CMD_REPLY_LEN     19u
+
 #include <stdio.h>
 #include <string.h>
+#include "profile.h"
 #include "protocol.h"
 #include "serial.h"
 #include "version.h"
 
-class moonlite: protected protocol, protected serial {
+#if !defined(USE_RS485_MULTIDROP) && !defined(DISABLE_BOOT_BANNER)
+  static const char s_banner[] PROGMEM =
+    "Ardufocus " ARDUFOCUS_VERSION "-" ARDUFOCUS_BRANCH " ready.\n"
+    "Visit " ARDUFOCUS_URL " for updates.\n\n";
+#endif
+
+template<uint8_t N> class moonlite: protected protocol, protected serial<N> {
+  private:
+    typedef serial<N> link;
+
+  #ifdef USE_RS485_MULTIDROP
+    bool m_silent = false;
+  #endif
+
+  #if !defined(USE_RS485_MULTIDROP) && !defined(DISABLE_BOOT_BANNER)
+    const char* m_banner = NULL;  // Next banner byte, NULL when done
+  #endif
+
+  #if defined(USE_FOCUS_PRESETS) || defined(USE_SOFT_LIMITS)
+    // Single hex digit index, 0xFF when invalid
+    static uint8_t nibble(const char& c) {
+      if(c >= '0' && c <= '9') { return c - '0'; }
+      if(c >= 'A' && c <= 'F') { return c - 'A' + 10; }
+      return 0xFF;
+    }
+  #endif
+
   public:
     moonlite() {
       setup();
     }
 
     void setup() {
-      serial::setup();
+      link::setup();
+
+      // All units on a multi-drop bus would talk at the same time
+      #if !defined(USE_RS485_MULTIDROP) && !defined(DISABLE_BOOT_BANNER)
+      m_banner = s_banner;
+      #endif
+    }
 
-      serial::write_P(PSTR("Ardufocus " ARDUFOCUS_VERSION "-" ARDUFOCUS_BRANCH " ready.\n"));
-      serial::write_P(PSTR("Visit " ARDUFOCUS_URL " for updates.\n\n"));
+    /**
+     * @brief   Send the boot banner without ever waiting on the link
+     * @details Called on every main loop pass, each call only queues what fits
+     *          on the TX buffer. The banner is abandoned as soon as a command
+     *          arrives so the first reply is never held back by it.
+     */
+    void banner() {
+      #if !defined(USE_RS485_MULTIDROP) && !defined(DISABLE_BOOT_BANNER)
+      if(! m_banner) { return; }
+
+      while(const char c = pgm_read_byte(m_banner)) {
+        if(! link::writable()) { return; }
+        link::write(c);
+        ++m_banner;
+      }
+
+      m_banner = NULL;
+      #endif
     }
 
+    /**
+     * @brief   Process every complete frame waiting on the link
+     * @details An interleaved burst of commands for both channels is answered
+     *          on a single pass of the main loop, in order.
+     */
     void receive() {
       char str[CMD_MAX_LEN];
-      if(serial::receive(str)) { parse(str); }
+      while(link::receive(str)) {
+        #if !defined(USE_RS485_MULTIDROP) && !defined(DISABLE_BOOT_BANNER)
+        if(m_banner) {
+          // Finish the line already started, if any
+          if(m_banner != s_banner && pgm_read_byte(m_banner - 1) != '\n') { link::write('\n'); }
+          m_banner = NULL;
+        }
+        #endif
+
+        #ifdef DEBUG_BOOT_PROFILE
+        if(! g_boot[BOOT_FIRST_REPLY]) { profile_boot(BOOT_FIRST_REPLY); }
+        #endif
+
+        #ifdef DEBUG_ISR_PROFILE
+        const uint16_t start = profile_now();
+        #endif
+
+        #ifdef USE_RS485_MULTIDROP
+        if(str[0] == CMD_ADDR_CHAR) {
+          char addr[3] = { str[1], str[2], 0 };
+          const uint8_t dest = util::hex2l(addr);
+
+          if(dest == get_bus_address()) { parse(str + 3); }
+          else if(dest == RS485_BROADCAST_ADDRESS) {
+            // Broadcast frames are never replied to
+            m_silent = true;
+            parse(str + 3);
+            m_silent = false;
+          }
+        }
+        else
+        #endif
+        parse(str);
+
+        #ifdef DEBUG_ISR_PROFILE
+        profile_cmd(start);
+        #endif
+      }
     }
 
     void reply(const char* str) {
-      serial::write(str);
-      serial::write(CMD_END_CHAR);
+      #ifdef USE_RS485_MULTIDROP
+      if(m_silent) { return; }
+      #endif
+
+      link::write(str);
+      link::write(CMD_END_CHAR);
     }
 
     void reply_P(const char* str) {
-      serial::write_P(str);
-      serial::write(CMD_END_CHAR);
+      #ifdef USE_RS485_MULTIDROP
+      if(m_silent) { return; }
+      #endif
+
+      link::write_P(str);
+      link::write(CMD_END_CHAR);
     }
 
     void parse(char* const str) {
       size_t offset = 0;
-      // Hack for using 2 motors on Moonlite's "Single Chanel controller": Make this variable static
-      /* static */ motor_t motor = MOTOR_ONE;
-      char buffer[CMD_MAX_LEN] = {0};
+      motor_t motor = MOTOR_ONE;
+      char buffer[CMD_REPLY_LEN] = {0};
 
-      if(str[0] == '2') {
+      // Moonlite DRO channel addressing, ":1GP#" and ":2GP#" query each
+      // channel while an unprefixed frame always goes to the first one. The
+      // channel is selected per frame thus both can be freely interleaved.
+      if(str[0] == '1' || str[0] == '2') {
         offset = 1;
-        motor = MOTOR_TWO;
+        motor = (str[0] == '2') ? MOTOR_TWO : MOTOR_ONE;
       }
-      // Hack for using 2 motors on Moonlite's "Signle Channel controller":
-      // If you send a "1" or a "2" from the config page, you can manipulate both motors.
-      // Caveat: There's only one position.  
-      /* else if (str[0] == '1') {
-        offset = 1;
-        motor = MOTOR_ONE;
-      } */
 
       switch (str[0 + offset]) {
         case 'C':
           update_temperature();
           break;
 
+        #ifdef USE_FOCUS_PRESETS
+        case 'R':
+          preset_recall(motor, nibble(str[1 + offset]));
+          break;
+        #endif
+
         #ifdef ENABLE_REMOTE_RESET
         case 'Z':
           system_reset(0);
@@ -90,14 +199,43 @@ class moonlite: protected protocol, protected serial {
         #endif
 
         case 'F':
-          switch(str[1] + offset) {
+          switch(str[1 + offset]) {
             case 'G':
                 motor_start(motor);
               break;
 
+            case 'H':
+                motor_home(motor);
+              break;
+
             case 'Q':
                 motor_stop(motor);
               break;
+
+            // Compound moves, each one replaces a read-modify-write sequence
+            // of queries and is applied against the live position
+            case 'N':
+              #ifdef HIGH_RESOLUTION_MODE
+              motor_set_target(motor, util::hex2ul(str + 2 + offset));
+              #else
+              motor_set_target(motor, (uint32_t)util::hex2l(str + 2 + offset));
+              #endif
+              motor_start(motor);
+              break;
+
+            case 'R':
+              // Signed delta, two's complement
+              #ifdef HIGH_RESOLUTION_MODE
+              motor_move_by(motor, (int32_t)util::hex2ul(str + 2 + offset));
+              #else
+              motor_move_by(motor, (int16_t)util::hex2l(str + 2 + offset));
+              #endif
+              break;
+
+            case 'D':
+              motor_set_speed(motor, util::hex2l(str + 2 + offset));
+              motor_start(motor);
+              break;
           } break;
 
         case 'G':
@@ -106,10 +244,30 @@ class moonlite: protected protocol, protected serial {
               sprintf_P(buffer, PSTR("%02X"), motor_get_speed(motor));
               break;
 
+            case 'E':
+              sprintf_P(buffer, PSTR("%04X"), get_eeprom_saves());
+              break;
+
+            #ifdef DEBUG_BOOT_PROFILE
+            case 'U': {
+              // ":GU#" is the time to the first command, ":GUn#" is phase n
+              const char c = str[2 + offset];
+              const uint8_t phase = (c >= '0' && c <= '9') ? c - '0' : BOOT_FIRST_REPLY;
+              sprintf_P(buffer, PSTR("%08lX"), get_boot_time(phase));
+              break;
+            }
+            #endif
+
             case 'H':
               sprintf_P(buffer, PSTR("%02X"), motor_get_mode(motor));
               break;
 
+            #ifdef HAS_TMC2209
+            case 'F':
+              sprintf_P(buffer, PSTR("%04X"), motor_get_stalls(motor));
+              break;
+            #endif
+
             case 'I':
               sprintf_P(buffer, PSTR("%02X"), motor_is_moving(motor));
               break;
@@ -122,6 +280,23 @@ class moonlite: protected protocol, protected serial {
               #endif
               break;
 
+            #ifdef USE_ISR_LOAD_SHEDDING
+            case 'O':
+              sprintf_P(buffer, PSTR("%04X"), get_isr_overloads());
+              break;
+            #endif
+
+            case 'S': {
+              // Timestamp in uS, position and moving flag of one instant
+              const sample_t smp = motor_get_sample(motor);
+              #ifdef HIGH_RESOLUTION_MODE
+              sprintf_P(buffer, PSTR("%08lX%08lX%02X"), smp.timestamp, smp.position, smp.moving);
+              #else
+              sprintf_P(buffer, PSTR("%08lX%04X%02X"), smp.timestamp, (uint16_t) smp.position, smp.moving);
+              #endif
+              break;
+            }
+
             case 'P':
               #ifdef HIGH_RESOLUTION_MODE
               sprintf_P(buffer, PSTR("%08lX"), motor_get_position(motor));
@@ -130,13 +305,83 @@ class moonlite: protected protocol, protected serial {
               #endif
               break;
 
-            case 'T':
+            case 'T': {
+              // Optional sensor index, ":GT1#" is the second sensor
+              const char c = str[2 + offset];
+              const uint8_t sensor = (c >= '0' && c <= '9') ? c - '0' : 0;
+
+              #ifdef HIGH_RESOLUTION_MODE
+              sprintf_P(buffer, PSTR("%08lX"), get_temperature(sensor));
+              #else
+              sprintf_P(buffer, PSTR("%04X"), ((int16_t)get_temperature(sensor)) << 1);
+              #endif
+              break;
+            }
+
+            #ifdef DEBUG_ISR_PROFILE
+            case 'J':
+              sprintf_P(buffer, PSTR("%08lX"), get_profile().loop_rate);
+              break;
+
+            case 'K': {
+              const profile_t p = get_profile();
+              sprintf_P(buffer, PSTR("%04X%04X"), p.cmd_max, p.cmd_last);
+              break;
+            }
+
+            case 'X': {
+              const profile_t p = get_profile();
+              sprintf_P(buffer, PSTR("%04X%04X"), p.isr_max, p.isr_last);
+              break;
+            }
+            #endif
+
+            #ifdef USE_RS485_MULTIDROP
+            case 'A':
+              sprintf_P(buffer, PSTR("%02X"), get_bus_address());
+              break;
+            #endif
+
+            #ifdef USE_ADAPTIVE_SLEEP
+            case 'L':
+              sprintf_P(buffer, PSTR("%02X"), motor_get_sleep_timeout(motor));
+              break;
+
+            case 'W':
+              sprintf_P(buffer, PSTR("%04X%04X"), motor_get_sleep_hits(motor), motor_get_sleep_misses(motor));
+              break;
+            #endif
+
+            #ifdef USE_FOCUS_PRESETS
+            case 'R':
+              #ifdef HIGH_RESOLUTION_MODE
+              sprintf_P(buffer, PSTR("%08lX"), preset_get(motor, nibble(str[2 + offset])));
+              #else
+              sprintf_P(buffer, PSTR("%04X"), (uint16_t) preset_get(motor, nibble(str[2 + offset])));
+              #endif
+              break;
+            #endif
+
+            #ifdef USE_FOCUS_LEARNING
+            case 'M':
+              // ":GM1#" is the fit quality instead of the slope
+              if(str[2 + offset] == '1') {
+                sprintf_P(buffer, PSTR("%02X%04X"), tempfit_get_confidence(motor), tempfit_get_samples(motor));
+              } else {
+                sprintf_P(buffer, PSTR("%08lX"), tempfit_get_slope(motor));
+              }
+              break;
+            #endif
+
+            #ifdef USE_SOFT_LIMITS
+            case 'Z':
               #ifdef HIGH_RESOLUTION_MODE
-              sprintf_P(buffer, PSTR("%08lX"), get_temperature());
+              sprintf_P(buffer, PSTR("%08lX"), limits_get(motor, nibble(str[2 + offset])));
               #else
-              sprintf_P(buffer, PSTR("%04X"), ((int16_t)get_temperature()) << 1);
+              sprintf_P(buffer, PSTR("%04X"), (uint16_t) limits_get(motor, nibble(str[2 + offset])));
               #endif
               break;
+            #endif
 
             #ifdef ENABLE_DTR_RESET
             case 'Y':
@@ -145,7 +390,8 @@ class moonlite: protected protocol, protected serial {
             #endif
 
             default:
-              reply_P(PSTR ("00"));
+              // Exactly one reply per query, a burst is matched by order
+              strcpy_P(buffer, PSTR("00"));
           }
 
           reply(buffer);
@@ -155,6 +401,18 @@ class moonlite: protected protocol, protected serial {
           strncpy(buffer, str + 2 + offset, strlen(str) - (2 + offset));
 
           switch(str[1 + offset]) {
+            #ifdef DEBUG_ISR_PROFILE
+            case 'X':
+              profile_reset();
+              break;
+            #endif
+
+            #ifdef USE_RS485_MULTIDROP
+            case 'A':
+              set_bus_address(util::hex2l(buffer));
+              break;
+            #endif
+
             case 'D':
               motor_set_speed(motor, util::hex2l(buffer));
               break;
@@ -187,6 +445,51 @@ class moonlite: protected protocol, protected serial {
               #endif
               break;
 
+            case 'S':
+              // Host clock in uS, the round trip delay is left to the host
+              set_clock(util::hex2ul(buffer));
+              break;
+
+            #ifdef USE_FOCUS_PRESETS
+            case 'R':
+              // Without a value the current position is stored
+              if(! buffer[1]) {
+                preset_set(motor, nibble(buffer[0]), PRESET_POSITION, motor_get_position(motor));
+              } else {
+                #ifdef HIGH_RESOLUTION_MODE
+                preset_set(motor, nibble(buffer[0]), PRESET_POSITION, util::hex2ul(buffer + 1));
+                #else
+                preset_set(motor, nibble(buffer[0]), PRESET_POSITION, (uint32_t)util::hex2l(buffer + 1));
+                #endif
+              }
+              break;
+
+            case 'U':
+              #ifdef HIGH_RESOLUTION_MODE
+              preset_set(motor, nibble(buffer[0]), PRESET_OFFSET, util::hex2ul(buffer + 1));
+              #else
+              preset_set(motor, nibble(buffer[0]), PRESET_OFFSET, (int32_t)(int16_t)util::hex2l(buffer + 1));
+              #endif
+              break;
+            #endif
+
+            #ifdef USE_FOCUS_LEARNING
+            case 'M':
+              if(buffer[0] == '0') { tempfit_clear(motor); }
+              else { tempfit_mark(motor); }
+              break;
+            #endif
+
+            #ifdef USE_SOFT_LIMITS
+            case 'Z':
+              #ifdef HIGH_RESOLUTION_MODE
+              limits_set(motor, nibble(buffer[0]), util::hex2ul(buffer + 1));
+              #else
+              limits_set(motor, nibble(buffer[0]), (uint32_t)util::hex2l(buffer + 1));
+              #endif
+              break;
+            #endif
+
             #ifdef ENABLE_DTR_RESET
             case 'Y':
               set_dtr_reset((buffer[0] == '1') ? true : false);
@@ -200,6 +503,10 @@ class moonlite: protected protocol, protected serial {
     }
 };
 
-static moonlite comms;
+static moonlite<0> comms;
+
+#ifdef USE_SERIAL_AUX
+static moonlite<1> comms_aux;
+#endif
 
 #endif
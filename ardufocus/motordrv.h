@@ -31,16 +31,30 @@
   #include "uln2003.h"
 #endif
 
-#if defined(MOTOR1_USE_A4988_DRIVER)
-  a4988   motor1drv({ MOTOR1_PINOUT });
+#if defined(MOTOR1_USE_TMC2209_DRIVER) || defined(MOTOR2_USE_TMC2209_DRIVER)
+  #include "tmc2209.h"
+#endif
+
+#if defined(MOTOR1_USE_DRV8825_DRIVER)
+  a4988<VARIANT_DRV8825> motor1drv({ MOTOR1_PINOUT });
+#elif defined(MOTOR1_USE_A4988_DRIVER)
+  a4988<> motor1drv({ MOTOR1_PINOUT });
 #elif defined(MOTOR1_USE_ULN2003_DRIVER)
   uln2003 motor1drv({ MOTOR1_PINOUT });
+#elif defined(MOTOR1_USE_TMC2209_DRIVER)
+  tmc2209 motor1drv({ MOTOR1_PINOUT }, { MOTOR1_TMC2209_ADDRESS, MOTOR1_TMC2209_CURRENT,
+    MOTOR1_TMC2209_MICROSTEPS, MOTOR1_TMC2209_STALL_THRESHOLD });
 #endif
 
-#if defined(MOTOR2_USE_A4988_DRIVER)
-  a4988   motor2drv({ MOTOR2_PINOUT });
+#if defined(MOTOR2_USE_DRV8825_DRIVER)
+  a4988<VARIANT_DRV8825> motor2drv({ MOTOR2_PINOUT });
+#elif defined(MOTOR2_USE_A4988_DRIVER)
+  a4988<> motor2drv({ MOTOR2_PINOUT });
 #elif defined(MOTOR2_USE_ULN2003_DRIVER)
   uln2003 motor2drv({ MOTOR2_PINOUT });
+#elif defined(MOTOR2_USE_TMC2209_DRIVER)
+  tmc2209 motor2drv({ MOTOR2_PINOUT }, { MOTOR2_TMC2209_ADDRESS, MOTOR2_TMC2209_CURRENT,
+    MOTOR2_TMC2209_MICROSTEPS, MOTOR2_TMC2209_STALL_THRESHOLD });
 #endif
 
 #endif
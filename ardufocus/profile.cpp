@@ -0,0 +1,48 @@
+/**
+ * Ardufocus - Moonlite compatible focuser
+ * Copyright (C) 2017-2019 João Brázio [joao@brazio.org]
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "profile.h"
+
+#ifdef DEBUG_ISR_PROFILE
+  volatile profile_t g_profile = { 0, 0, 0, 0, 0, 0 };
+
+  void profile_init()
+  {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      // Cleanup all the relevant registers
+      TCCR1A = 0; TCCR1B = 0; TIMSK1 = 0;
+      TIFR1  = 0; TCNT1  = 0;
+
+      // normal mode, clock select to clk/1
+      TCCR1B |= bit(CS10);
+    }
+  }
+
+  void profile_reset()
+  {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      g_profile.isr_max = 0;
+      g_profile.cmd_max = 0;
+    }
+  }
+#endif
+
+#ifdef DEBUG_BOOT_PROFILE
+  uint32_t g_boot[BOOT_PHASES] = { 0 };
+#endif
@@ -0,0 +1,106 @@
+/**
+ * Ardufocus - Moonlite compatible focuser
+ * Copyright (C) 2017-2019 João Brázio [joao@brazio.org]
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __PROFILE_H__
+#define __PROFILE_H__
+
+#include "config.h"
+
+#include <stdint.h>
+#include <avr/io.h>
+#include <util/atomic.h>
+#include "macro.h"
+
+#ifdef DEBUG_ISR_PROFILE
+
+/**
+ * When DEBUG_ISR_PROFILE is defined Timer1 runs free at F_CPU and is used to
+ * measure, in CPU cycles, the run time of the step ISR and the turnaround of
+ * each command (from reception to the reply being queued). Timer1 wraps every
+ * 65536 cycles, thus anything longer than ~4ms (i.e. an EEPROM write) will
+ * alias into a smaller value.
+ */
+struct profile_t {
+  uint16_t isr_last, isr_max; // Step ISR run time (cycles)
+  uint16_t cmd_last, cmd_max; // Command turnaround (cycles)
+  uint32_t loop_cnt;          // Main loop iterations (running counter)
+  uint32_t loop_rate;         // Main loop iterations during the last second
+};
+
+extern volatile profile_t g_profile;
+
+void profile_init();
+void profile_reset();
+
+// The main loop must not be interrupted between the two byte reads, the step
+// ISR reads TCNT1 as well and would overwrite the shared TEMP register
+inline uint16_t profile_now() {
+  uint16_t t;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) { t = TCNT1; }
+  return t;
+}
+
+inline void profile_isr(const uint16_t& start) {
+  const uint16_t dt = TCNT1 - start;
+  g_profile.isr_last = dt;
+  if(dt > g_profile.isr_max) { g_profile.isr_max = dt; }
+}
+
+inline void profile_cmd(const uint16_t& start) {
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    const uint16_t dt = TCNT1 - start;
+    g_profile.cmd_last = dt;
+    if(dt > g_profile.cmd_max) { g_profile.cmd_max = dt; }
+  }
+}
+
+inline void profile_loop() {
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) { ++g_profile.loop_cnt; }
+}
+
+#endif
+
+#ifdef DEBUG_BOOT_PROFILE
+
+#include "uptime.h"
+
+/**
+ * When DEBUG_BOOT_PROFILE is defined the uptime (uS) at the end of each setup
+ * phase is recorded, plus the moment the first command frame was served. The
+ * clock starts at the top of main() thus the C runtime init is not included.
+ */
+enum boot_phase_t {
+  BOOT_EEPROM,
+  BOOT_SENSORS,
+  BOOT_UI,
+  BOOT_MOTORS,
+  BOOT_READY,
+  BOOT_FIRST_REPLY,
+  BOOT_PHASES
+};
+
+extern uint32_t g_boot[BOOT_PHASES];
+
+inline void profile_boot(const boot_phase_t& phase) {
+  g_boot[phase] = uptime_us();
+}
+
+#endif
+
+#endif
@@ -35,40 +35,67 @@
 #include <util/atomic.h>
 #include "avr_usart.h"
 #include "eeprom.h"
+#include "io.h"
 
 #ifndef CMD_MAX_LEN
   #define CMD_MAX_LEN 9u
 #endif
 
-class serial {
+/**
+ * @brief   Interrupt driven serial port
+ * @details The template parameter selects the USART (see usart::regs), each
+ *          port has its own ring buffers and command reception context.
+ */
+template<uint8_t N> class serial {
+  private:
+    typedef usart::regs<N> port;
+
   protected:
     void setup() {
       ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
         // Defines the speed at which the serial line will operate.
         // The default settings are: 8-bit, no parity, 1 stop bit.
-        const uint16_t baud_rate = ((F_CPU / (8L * 9600)) - 1) /2;
-        USART_CSRA &= ~bit(USART_BIT_U2X); // baud doubler off
+        const uint16_t baud_rate = ((F_CPU / (8L * port::baud)) - 1) /2;
+        port::csra() &= ~bit(USART_BIT_U2X); // baud doubler off
 
         // set baudrate
-        USART_BRRH = baud_rate >> 8;
-        USART_BRRL = baud_rate;
+        port::brrh() = baud_rate >> 8;
+        port::brrl() = baud_rate;
 
         // enable rx and tx
-        USART_CSRB |= bit(USART_BIT_RXEN);
-        USART_CSRB |= bit(USART_BIT_TXEN);
+        port::csrb() |= bit(USART_BIT_RXEN);
+        port::csrb() |= bit(USART_BIT_TXEN);
 
         // enable interrupt on complete reception of a byte
-        USART_CSRB |= bit(USART_BIT_RXCIE);
+        port::csrb() |= bit(USART_BIT_RXCIE);
+
+        #ifdef USE_RS485_MULTIDROP
+          // RS-485 transceiver starts in receive mode
+          if(N == 0) {
+            IO::set_as_output(RS485_DE_PINOUT);
+            IO::write(RS485_DE_PINOUT, LOW);
+          }
+        #endif
       }
     }
 
+    // True when a byte can be written without waiting
+    bool writable() {
+      return ! usart::buffer[N].tx.full();
+    }
+
     size_t write(const char& c) {
       // wait until there is space in the buffer
-      while (!usart::buffer.tx.enqueue(c)) flush();
+      while (!usart::buffer[N].tx.enqueue(c)) flush();
+
+      #ifdef USE_RS485_MULTIDROP
+        // take control of the RS-485 bus
+        if(N == 0) { IO::write(RS485_DE_PINOUT, HIGH); }
+      #endif
 
       // Enable Data Register Empty Interrupt
       // to make sure tx-streaming is running
-      USART_CSRB |= bit(USART_BIT_DRIE);
+      port::csrb() |= bit(USART_BIT_DRIE);
 
       return 1;
     }
@@ -96,8 +123,8 @@ class serial {
       static char buff[CMD_MAX_LEN];
 
       ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
-        while(!usart::buffer.rx.empty()) {
-          switch(const char c = usart::buffer.rx.dequeue()) {
+        while(!usart::buffer[N].rx.empty()) {
+          switch(const char c = usart::buffer[N].rx.dequeue()) {
             // process the data on the buffer
             case CMD_END_CHAR: {
               strcpy(str, buff);
@@ -135,16 +162,22 @@ class serial {
 
     void flush() {
       ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
-        while (bit_is_set(USART_CSRB, USART_BIT_DRIE) || bit_is_clear(USART_CSRA, USART_BIT_TXC)) {
-          if (bit_is_set(USART_CSRB, USART_BIT_DRIE) && bit_is_clear(SREG, SREG_I)) {
-            if (bit_is_set(USART_CSRA, USART_BIT_DRE)) {
+        while (bit_is_set(port::csrb(), USART_BIT_DRIE) || bit_is_clear(port::csra(), USART_BIT_TXC)) {
+          if (bit_is_set(port::csrb(), USART_BIT_DRIE) && bit_is_clear(SREG, SREG_I)) {
+            if (bit_is_set(port::csra(), USART_BIT_DRE)) {
               // send a byte from the buffer
-              USART_DR = usart::buffer.tx.dequeue();
-              USART_CSRA |= bit(USART_BIT_TXC);
+              port::dr() = usart::buffer[N].tx.dequeue();
+              port::csra() |= bit(USART_BIT_TXC);
 
               // turn off Data Register Empty Interrupt
               // to stop tx-streaming if this concludes the transfer
-              if (usart::buffer.tx.empty()) { USART_CSRB &= ~bit(USART_BIT_DRIE); }
+              if (usart::buffer[N].tx.empty()) {
+                port::csrb() &= ~bit(USART_BIT_DRIE);
+
+                #ifdef USE_RS485_MULTIDROP
+                  if(N == 0) { port::csrb() |= bit(USART_BIT_TXCIE); }
+                #endif
+              }
             }
           }
         }
@@ -0,0 +1,79 @@
+/**
+ * Ardufocus - Moonlite compatible focuser
+ * Copyright (C) 2017-2019 João Brázio [joao@brazio.org]
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "shiftreg.h"
+
+#ifdef USE_SHIFT_REGISTER
+
+#include "io.h"
+
+// Hardware SPI pins
+#define SHIFT_REGISTER_MOSI_PINOUT 11
+#define SHIFT_REGISTER_SCK_PINOUT  13
+#define SHIFT_REGISTER_SS_PINOUT   10
+
+/**
+ * @brief Static class member initialization
+ */
+uint8_t ShiftReg::s_shadow[SHIFT_REGISTER_COUNT] = { 0 };
+uint8_t ShiftReg::s_hold = 0;
+
+/**
+ * @brief Configure the SPI port and clear all outputs
+ *
+ */
+void ShiftReg::setup()
+{
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    IO::set_as_output(SHIFT_REGISTER_MOSI_PINOUT);
+    IO::set_as_output(SHIFT_REGISTER_SCK_PINOUT);
+    IO::set_as_output(SHIFT_REGISTER_LATCH_PINOUT);
+
+    // As an input a low level on SS drops the SPI out of master mode and the
+    // transfer never ends, it must be an output even when not the latch
+    IO::set_as_output(SHIFT_REGISTER_SS_PINOUT);
+    IO::write(SHIFT_REGISTER_LATCH_PINOUT, LOW);
+
+    // SPI master, mode 0, MSB first, clock select to clk/2
+    SPCR = bit(SPE) | bit(MSTR);
+    SPSR = bit(SPI2X);
+
+    update();
+  }
+}
+
+/**
+ * @brief Shift the shadow register out and latch it
+ * @details The first byte sent ends up on the farthest register, thus the
+ *          shadow is sent backwards. Must be called with interrupts off.
+ *
+ */
+void ShiftReg::update()
+{
+  for(uint8_t i = SHIFT_REGISTER_COUNT; i > 0; i--) {
+    SPDR = s_shadow[i - 1];
+    while(bit_is_clear(SPSR, SPIF)) { ; }
+  }
+
+  // the outputs are updated on the rising edge
+  IO::write(SHIFT_REGISTER_LATCH_PINOUT, HIGH);
+  IO::write(SHIFT_REGISTER_LATCH_PINOUT, LOW);
+}
+
+#endif
@@ -0,0 +1,80 @@
+/**
+ * Ardufocus - Moonlite compatible focuser
+ * Copyright (C) 2017-2019 João Brázio [joao@brazio.org]
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __SHIFTREG_H__
+#define __SHIFTREG_H__
+
+#include "config.h"
+
+#include <stdint.h>
+#include <avr/io.h>
+#include <util/atomic.h>
+#include "macro.h"
+
+#ifdef USE_SHIFT_REGISTER
+
+/**
+ * @brief   74HC595 output expander on the hardware SPI port
+ * @details The outputs are kept on a shadow register which is shifted out,
+ *          whole, on every change. Between hold() and release() changes only
+ *          update the shadow and the chain is written once on release.
+ */
+class ShiftReg
+{
+  /**
+   * Disable the creation of an instance of this object.
+   * This class should be used as a static class.
+   */
+  private:
+     ShiftReg() {;}
+    ~ShiftReg() {;}
+
+    static uint8_t s_shadow[SHIFT_REGISTER_COUNT];
+    static uint8_t s_hold;
+
+    static void update();
+
+  public:
+    static void setup();
+
+    static inline void write(const uint8_t& n, const bool& value) {
+      ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        if(value) { s_shadow[n >> 3] |=  bit(n & 7); }
+        else      { s_shadow[n >> 3] &= ~bit(n & 7); }
+        if(! s_hold) { update(); }
+      }
+    }
+
+    static inline bool read(const uint8_t& n) {
+      return s_shadow[n >> 3] & bit(n & 7);
+    }
+
+    static inline void hold() {
+      ATOMIC_BLOCK(ATOMIC_RESTORESTATE) { ++s_hold; }
+    }
+
+    static inline void release() {
+      ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        if(s_hold && ! --s_hold) { update(); }
+      }
+    }
+};
+
+#endif
+#endif
@@ -18,6 +18,7 @@
  */
 
 #include "stepper.h"
+#include "isr.h"
 
 /**
  * @brief [brief description]
@@ -40,8 +41,42 @@ void stepper::init()
  */
 void stepper::move()
 {
+  #ifdef USE_ADAPTIVE_SLEEP
+    learn_sleep_timeout();
+  #endif
+
   m_ovf_counter = 0;
   m_position.moving = true;
+  timer0_wake();
+}
+
+
+/**
+ * @brief Start a move relative to the target
+ * @details
+ * The delta is added to the target rather than to the current position, when
+ * idle both are the same and during a move the delta extends it. Reading the
+ * target and setting the new one is a single atomic operation thus the step
+ * ISR can never slip a step in between. The result saturates at both ends of
+ * the counter.
+ *
+ */
+void stepper::move_by(const int32_t& delta)
+{
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    const uint32_t base = m_position.target;
+    uint32_t target = base + delta;
+
+    if(delta < 0 && target > base) { target = 0; }
+    else if(delta > 0 && target < base) { target = UINT32_MAX; }
+
+    #ifndef HIGH_RESOLUTION_MODE
+      if(target > UINT16_MAX) { target = (delta < 0) ? 0 : UINT16_MAX; }
+    #endif
+
+    set_target_position(target);
+    move();
+  }
 }
 
 
@@ -67,10 +102,59 @@ void stepper::halt()
   ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
     m_position.target = m_position.current;
     m_position.moving = false;
+    m_step_units = 1;
+
+    #ifdef USE_ADAPTIVE_SLEEP
+      m_idle_since = g_uptime_ms;
+    #endif
   }
 }
 
 
+#ifdef USE_ADAPTIVE_SLEEP
+  /**
+   * @brief Adapt the sleep timeout to the move cadence
+   * @details
+   * Called when a new move starts, the idle interval since the previous move
+   * is fed into a moving average which is used to predict the next interval.
+   * When the prediction fits inside the allowed bounds the motor is kept
+   * powered slightly longer than that, otherwise there is no point in holding
+   * and the motor will sleep as soon as allowed.
+   *
+   */
+  void stepper::learn_sleep_timeout()
+  {
+    if(! m_sleep_when_idle || m_position.moving) { return; }
+
+    uint32_t idle;
+    bool powered;
+
+    // The step timer is stopped while idle, the interval is taken from the
+    // uptime clock instead of counting ticks
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      idle    = g_uptime_ms - m_idle_since;
+      powered = (m_sleep_timeout_cnt > 0);
+    }
+
+    if(powered) { if(m_sleep_hits   < UINT16_MAX) { ++m_sleep_hits;   } }
+    else        { if(m_sleep_misses < UINT16_MAX) { ++m_sleep_misses; } }
+
+    // mS to 1/16 sec
+    idle = (idle > 0x7FFFFFFFUL) ? UINT32_MAX : (idle << 1) / 125;
+    if(idle > UINT16_MAX) { idle = UINT16_MAX; }
+    m_idle_avg = (m_idle_avg >> 1) + (idle >> 1);
+
+    // Predicted interval plus a 25% margin, in seconds
+    const uint16_t predicted = ((uint32_t) m_idle_avg + (m_idle_avg >> 2)) >> 4;
+
+    if(predicted < ADAPTIVE_SLEEP_MAX_TIMEOUT) {
+      m_sleep_timeout = (predicted < ADAPTIVE_SLEEP_MIN_TIMEOUT)
+        ? ADAPTIVE_SLEEP_MIN_TIMEOUT : predicted + 1;
+    } else { m_sleep_timeout = ADAPTIVE_SLEEP_MIN_TIMEOUT; }
+  }
+#endif
+
+
 /**
  * @brief [brief description]
  * @details [long description]
@@ -140,16 +224,41 @@ uint32_t stepper::get_target_position()
  * @details [long description]
  *
  */
-void stepper::set_target_position(const uint32_t& target) {
+void stepper::set_target_position(const uint32_t& position) {
+  #ifdef USE_SOFT_LIMITS
+    // Jogs ask for either end of the counter, they stop at the limit instead
+    const uint32_t target = constrain(position, m_limit_min, m_limit_max);
+  #else
+    const uint32_t target = position;
+  #endif
+
   ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    #ifdef HAS_ACCELERATION
+      // Retargeting a move in the same direction keeps its current speed, the
+      // ramp is resumed from the point with the same speed by prepending the
+      // steps it took to reach it. A reversal starts again from standstill.
+      uint32_t ramp = 0;
+
+      if(m_position.moving && m_position.distance >= ACCEL_MIN_STEPS
+        && (target > m_position.current) == (m_position.target > m_position.current)) {
+        ramp = (m_position.relative < m_position.easein) ? m_position.relative
+          : (m_position.relative >= m_position.easeout)
+          ? m_position.distance - m_position.relative : m_position.easein;
+      }
+    #endif
+
     m_position.target = target;
 
+    #ifdef USE_SOFT_LIMITS
+      update_zone();
+    #endif
+
     #ifdef HAS_ACCELERATION
-      m_position.relative = 0;
+      m_position.relative = ramp;
 
-      m_position.distance = (m_position.current > target)
+      m_position.distance = ramp + ((m_position.current > target)
         ? m_position.current - target
-        : target - m_position.current;
+        : target - m_position.current);
 
       if (m_position.distance >= ACCEL_MIN_STEPS)
       {
@@ -172,23 +281,83 @@ void stepper::set_target_position(const uint32_t& target) {
       }
     #endif
   }
+
+  if(m_position.moving) { timer0_wake(); }
 }
 
 
+#ifdef USE_SOFT_LIMITS
+  /**
+   * @brief Set the soft travel limits
+   * @details A move in progress is clamped to the new limits right away, the
+   *          width of the slow zones at each end is given in steps and zero
+   *          disables them, as is a target set with ":SN#" but not yet
+   *          started. An idle motor left outside the limits keeps its target
+   *          on the current position, the next move is the one that gets
+   *          clamped.
+   *
+   */
+  void stepper::set_limits(const uint32_t& lower, const uint32_t& upper, const uint32_t& zone)
+  {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      m_limit_min = lower;
+      m_limit_max = upper;
+      m_slow_zone = zone;
+
+      if(m_position.moving || m_position.target != m_position.current) {
+        const uint32_t target = m_position.target;
+        set_target_position(target);
+      }
+    }
+  }
+
+
+  /**
+   * @brief Speed cap for the distance left to the limit ahead
+   * @details
+   * Inside the slow zone the speed ramps linearly down to the minimum speed at
+   * the limit, outside of it the planner speed is used unchanged. Only the
+   * limit in the direction of travel matters, moving away from an end is
+   * never slowed down.
+   *
+   */
+  void stepper::update_zone()
+  {
+    if(! m_slow_zone || m_position.target == m_position.current) {
+      m_zone_speed = UINT16_MAX;
+      return;
+    }
+
+    const uint32_t d = (m_position.target > m_position.current)
+      ? m_limit_max - m_position.current
+      : m_position.current - m_limit_min;
+
+    m_zone_speed = (d >= m_slow_zone) ? UINT16_MAX : m_min_speed +
+      (uint16_t) (((uint32_t) (m_max_speed - m_min_speed) * d) / m_slow_zone);
+  }
+#endif
+
+
 /**
  * @brief Method called from ISR to change the motor state(s)
  * @details 
  * Calls virtual methods for doing the actual work (see respective child classes for details)
  * If appropriate send stepper motor drivers into sleep mode.
  * If appropriate issue a clock-wise or counter-clock-wise step and update the focusers position.
+ * When shed is set the ISR is running late, the sleep counter is left untouched and the
+ * stepping frequency from the previous step is reused.
  */
-void stepper::tick()
+void stepper::tick(const bool& shed)
 {
   // Movement guard
-  if (! m_position.moving) { sleep(); return; }
+  if (! m_position.moving) {
+    if(! shed) { sleep(); }
+    return;
+  }
 
-  // Step frequency generator
-  if((m_ovf_counter++) < (TIMER0_FREQ / (m_set_speed<<1)) -1) { return; }
+  // Step frequency generator, the planned frequency is in position units thus
+  // a step that moved more than one unit is followed by a longer interval
+  if((m_ovf_counter++) < ((TIMER0_FREQ * m_step_units) / (step_freq()<<1)) -1) { return; }
   m_ovf_counter = 0;
 
   // Speed control
@@ -199,12 +368,12 @@ void stepper::tick()
 
   // Move outwards
   if (m_position.target > m_position.current) {
-    if ((m_invert_direction) ? step_cw() : step_ccw()) { update_position(1); }
+    if ((m_invert_direction) ? step_cw() : step_ccw()) { update_position(m_step_units, shed); }
   }
 
   // Move inwards
   else if (m_position.target < m_position.current) {
-    if ((m_invert_direction) ? step_ccw() : step_cw()) { update_position(-1); }
+    if ((m_invert_direction) ? step_ccw() : step_cw()) { update_position(-m_step_units, shed); }
   }
 
   // Stop movement
@@ -253,14 +422,24 @@ void stepper::tick()
  * @details [long description]
  *
  */
-void stepper::update_position(const int8_t &direction)
+void stepper::update_position(const int8_t &direction, const bool &shed)
 {
+  #ifndef HAS_ACCELERATION
+    (void) shed;
+  #endif
+
   ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
     m_position.current += direction;          // Update the global position
 
     #ifdef HAS_ACCELERATION
-      ++m_position.relative;  // Update the relative position
-      update_freq();          // Update the stepping frequency
+      m_position.relative += (direction < 0) ? -direction : direction; // Update the relative position
+      if(! shed) {
+        update_freq();        // Update the stepping frequency
+      }
+    #endif
+
+    #ifdef USE_SOFT_LIMITS
+      if(! shed) { update_zone(); }
     #endif
   }
 }
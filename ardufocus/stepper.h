@@ -28,6 +28,15 @@
 #include "io.h"
 #include "utility.h"
 
+// Last stepping mode command, the driver resolution it maps to depends on the
+// driver and on MOTORn_MICROSTEPPING
+enum mode_cmd_t {
+  MODE_CMD_NONE,      // Driver default from init()
+  MODE_CMD_FULL,
+  MODE_CMD_HALF,
+  MODE_CMD_QUARTER
+};
+
 class stepper
 {
   public:
@@ -49,9 +58,11 @@ class stepper
 
   protected:
     uint8_t m_mode;                  // Stepping mode (1/1, 1/2, ..)
+    uint8_t m_mode_cmd = MODE_CMD_NONE; // Command which selected m_mode
     volatile uint16_t m_speed;       // Stepping speed
     volatile position_t m_position;  // Absolute motor position
     volatile uint16_t m_ovf_counter; // Overflow counter
+    uint8_t m_step_units = 1;        // Position units moved by the last step
 
     bool m_sleep_when_idle;          // Disable power to the motor when idle
     bool m_invert_direction;         // Invert the direction of rotation
@@ -63,23 +74,60 @@ class stepper
     uint8_t  m_sleep_timeout     = DEFAULT_SLEEP_TIMEOUT;
     uint32_t m_sleep_timeout_cnt = 0;
 
+    #ifdef USE_ADAPTIVE_SLEEP
+    volatile uint32_t m_idle_since = 0; // Uptime (mS) when the last move ended
+    uint16_t m_idle_avg     = 0;      // Average idle interval (1/16 sec)
+    uint16_t m_sleep_hits   = 0;      // Moves started with the motor powered
+    uint16_t m_sleep_misses = 0;      // Moves started with the motor asleep
+    #endif
+
+    #ifdef USE_SOFT_LIMITS
+    uint32_t m_limit_min = 0;               // Lowest reachable position
+    uint32_t m_limit_max = UINT32_MAX;      // Highest reachable position
+    uint32_t m_slow_zone = 0;               // Slow zone width at each end
+    volatile uint16_t m_zone_speed = UINT16_MAX; // Speed cap inside a zone
+    #endif
+
   protected:
     #ifdef HAS_ACCELERATION
     inline speed void update_freq();
     #endif
-    inline speed void update_position(const int8_t&);
+    inline speed void update_position(const int8_t&, const bool&);
+
+    // Planned stepping frequency, before the Moonlite speed divider
+    inline uint16_t step_freq() {
+      #ifdef USE_SOFT_LIMITS
+        return (m_zone_speed < m_set_speed) ? m_zone_speed : m_set_speed;
+      #else
+        return m_set_speed;
+      #endif
+    }
+
+    #ifdef USE_SOFT_LIMITS
+    inline speed void update_zone();
+    #endif
+
+    #ifdef USE_ADAPTIVE_SLEEP
+    void learn_sleep_timeout();
+    #endif
 
   public:
     virtual void init();
     virtual void halt();
 
     virtual inline void sleep()                        { ; }
+    virtual inline void power_down()                   { ; }
     virtual inline void set_full_step()                { ; }
     virtual inline void set_half_step()                { ; }
     virtual inline void set_quarter_step()             { ; }
+    virtual inline bool home()                         { return false;              }
+    virtual inline uint16_t get_stalls()               { return 0;                  }
 
     virtual inline uint8_t get_step_mode()             { return m_mode;             }
 
+    inline uint8_t get_mode_cmd()                      { return m_mode_cmd;         }
+    inline void    set_mode_cmd(const mode_cmd_t& c)   { m_mode_cmd = c;            }
+
     virtual inline bool step_cw()                      { return false;              }
     virtual inline bool step_ccw()                     { return false;              }
 
@@ -98,9 +146,18 @@ class stepper
     inline uint8_t get_sleep_timeout()                 { return m_sleep_timeout;    }
     inline void    set_sleep_timeout(uint8_t const& t) { m_sleep_timeout = t;       }
 
+    #ifdef USE_ADAPTIVE_SLEEP
+    inline uint16_t get_sleep_hits()                   { return m_sleep_hits;       }
+    inline uint16_t get_sleep_misses()                 { return m_sleep_misses;     }
+    #endif
+
     void move();
+    void move_by(const int32_t&);
     bool is_moving();
-    void speed tick();
+
+    // Moving or counting down to sleep, i.e. needs the step timer running
+    inline bool is_active() { return m_position.moving || (m_sleep_when_idle && m_sleep_timeout_cnt); }
+    void speed tick(const bool& shed = false);
 
     uint16_t get_speed();
     void     set_speed(const uint16_t&);
@@ -109,6 +166,10 @@ class stepper
     void     set_current_position(const uint32_t&);
     uint32_t get_target_position ();
     void     set_target_position (const uint32_t&);
+
+    #ifdef USE_SOFT_LIMITS
+    void set_limits(const uint32_t&, const uint32_t&, const uint32_t&);
+    #endif
 };
 
 #endif
@@ -0,0 +1,92 @@
+/**
+ * Ardufocus - Moonlite compatible focuser
+ * Copyright (C) 2017-2019 João Brázio [joao@brazio.org]
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "tempfit.h"
+
+#ifdef USE_FOCUS_LEARNING
+
+#include <string.h>
+
+void tempfit_reset(tempfit_t* fit)
+{
+  memset(fit, 0, sizeof(tempfit_t));
+}
+
+/**
+ * @brief Add a (temperature, best focus position) sample
+ * @details Temperature in 1/16 of a degree Celsius.
+ *
+ */
+void tempfit_add(tempfit_t* fit, const int16_t& t, const uint32_t& position)
+{
+  if(fit->n == UINT16_MAX) { return; }
+
+  if(fit->n == 0) {
+    fit->x0 = t;
+    fit->y0 = position;
+  }
+
+  const int64_t x = (int32_t) t - fit->x0;
+  const int64_t y = (int64_t) position - fit->y0;
+
+  ++fit->n;
+  fit->sx  += x;
+  fit->sy  += y;
+  fit->sxx += x * x;
+  fit->sxy += x * y;
+  fit->syy += y * y;
+}
+
+/**
+ * @brief Learned slope in 1/100 of a step per degree Celsius
+ * @details Zero until two samples at different temperatures exist.
+ *
+ */
+int32_t tempfit_slope(const tempfit_t* fit)
+{
+  const int64_t den = (int64_t) fit->n * fit->sxx - fit->sx * fit->sx;
+  if(fit->n < 2 || den == 0) { return 0; }
+
+  const int64_t num = (int64_t) fit->n * fit->sxy - fit->sx * fit->sy;
+
+  // x is in 1/16 C: steps/C = 16 * num / den, rounded half away from zero
+  const int64_t q = (num * 1600) / den;
+  const int64_t r = ((num * 1600) % den) * 2;
+  return q + ((r >= den) ? 1 : (r <= -den) ? -1 : 0);
+}
+
+/**
+ * @brief Goodness of the fit, the coefficient of determination in percent
+ * @details The ratio of the two large products is only evaluated here, on
+ *          request, thus the update path stays integer only.
+ *
+ */
+uint8_t tempfit_confidence(const tempfit_t* fit)
+{
+  const int64_t vx  = (int64_t) fit->n * fit->sxx - fit->sx * fit->sx;
+  const int64_t vy  = (int64_t) fit->n * fit->syy - fit->sy * fit->sy;
+  const int64_t cxy = (int64_t) fit->n * fit->sxy - fit->sx * fit->sy;
+
+  if(fit->n < 3 || vx <= 0 || vy <= 0) { return 0; }
+
+  const float r2 = ((float) cxy / vx) * ((float) cxy / vy);
+  return (uint8_t) (r2 * 100.0F + 0.5F);
+}
+
+#endif
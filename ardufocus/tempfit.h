@@ -0,0 +1,48 @@
+/**
+ * Ardufocus - Moonlite compatible focuser
+ * Copyright (C) 2017-2019 João Brázio [joao@brazio.org]
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __TEMPFIT_H__
+#define __TEMPFIT_H__
+
+#include "config.h"
+
+#include <stdint.h>
+
+/**
+ * Incremental least-squares fit of best focus position against temperature.
+ *
+ * Only the running sums are kept, thus every sample costs a constant amount of
+ * memory. Temperatures are in 1/16 of a degree and both axis are stored
+ * relative to the first sample, this keeps the sums small enough to be exact
+ * on 64-bit integers for any realistic number of samples.
+ */
+struct tempfit_t {
+  uint16_t n;                 // Number of samples
+  int16_t  x0;                // First temperature (1/16 C)
+  uint32_t y0;                // First position (steps)
+  int64_t  sx, sy;            // Sum of x and y
+  int64_t  sxx, sxy, syy;     // Sum of the products
+};
+
+void    tempfit_reset(tempfit_t*);
+void    tempfit_add(tempfit_t*, const int16_t&, const uint32_t&);
+int32_t tempfit_slope(const tempfit_t*);
+uint8_t tempfit_confidence(const tempfit_t*);
+
+#endif
@@ -0,0 +1,334 @@
+/**
+ * Ardufocus - Moonlite compatible focuser
+ * Copyright (C) 2017-2019 João Brázio [joao@brazio.org]
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "tmc2209.h"
+
+#ifdef HAS_TMC2209
+
+#include <util/delay.h>
+
+// Register map
+#define TMC2209_GCONF       0x00
+#define TMC2209_IHOLD_IRUN  0x10
+#define TMC2209_TPOWERDOWN  0x11
+#define TMC2209_TCOOLTHRS   0x14
+#define TMC2209_SGTHRS      0x40
+#define TMC2209_CHOPCONF    0x6C
+
+// GCONF: pdn_disable, mstep_reg_select, multistep_filt (stealthChop)
+#define TMC2209_GCONF_VAL   (bit(6) | bit(7) | bit(8))
+
+// CHOPCONF: intpol (interpolation to 1/256), toff = 3, hstrt = 5
+#define TMC2209_CHOPCONF_VAL 0x10000053UL
+
+#define TMC2209_UART_BIT_US (1000000.0 / TMC2209_UART_BAUD)
+
+// Internal clock, TSTEP counts its periods between two 1/256 microsteps
+#define TMC2209_FCLK 12000000UL
+
+/**
+ * @brief Initialize the driver pins and registers
+ * @details The motor current, microstepping resolution and StallGuard
+ * threshold are written over the UART, the interpolation to 1/256 is always
+ * enabled.
+ *
+ */
+void tmc2209::init()
+{
+  stepper::init();
+
+  IO::set_as_output(m_pinout.enable);
+  IO::set_as_output(m_pinout.step);
+  IO::set_as_output(m_pinout.direction);
+  IO::set_as_output(m_pinout.uart);
+  IO::set_as_input(m_pinout.diag);
+
+  IO::write(m_pinout.step,      LOW);
+  IO::write(m_pinout.direction, LOW);
+  IO::write(m_pinout.uart,      HIGH);
+
+  // active low logic
+  IO::write(m_pinout.enable, (m_sleep_when_idle) ? HIGH : LOW);
+
+  // Run current to CS, IRMS = (CS + 1) / 32 * 0.325V / (Rsense + 20mR) / sqrt(2)
+  uint32_t cs = ((uint32_t) m_config.current * (TMC2209_RSENSE + 20) * 1414UL) / 10156250UL;
+  cs = (cs > 32) ? 31 : (cs > 0) ? cs - 1 : 0;
+
+  write_reg(TMC2209_GCONF,      TMC2209_GCONF_VAL);
+  write_reg(TMC2209_IHOLD_IRUN, (8UL << 16) | (cs << 8) | (cs >> 1));
+  write_reg(TMC2209_TPOWERDOWN, 20);
+  write_reg(TMC2209_SGTHRS,     m_config.stall);
+
+  // MRES: 0 = 1/256 .. 8 = full step
+  uint8_t mres = 8;
+  for(uint16_t n = m_config.microsteps; n > 1 && mres > 0; n >>= 1) { --mres; }
+  m_mode = (mres < 8) ? 0xFF : 0x00;
+  set_mres(mres);
+}
+
+
+/**
+ * @brief Write a register over the single wire UART
+ * @details Bit banged, one byte at a time with the interrupts disabled.
+ *          The pin is driven directly through its port registers so the bit
+ *          timing is not skewed by the pin table lookups.
+ *
+ */
+void tmc2209::write_reg(const uint8_t& reg, const uint32_t& value)
+{
+  uint8_t datagram[8] = {
+    0x05, m_config.address, (uint8_t) (reg | 0x80),
+    (uint8_t) (value >> 24), (uint8_t) (value >> 16),
+    (uint8_t) (value >>  8), (uint8_t) (value), 0
+  };
+
+  // CRC8, polynomial x^8 + x^2 + x + 1, bytes are fed LSB first
+  uint8_t crc = 0;
+  for(uint8_t i = 0; i < 7; i++) {
+    uint8_t b = datagram[i];
+    for(uint8_t j = 0; j < 8; j++) {
+      crc = ((crc >> 7) ^ (b & 0x01)) ? (crc << 1) ^ 0x07 : (crc << 1);
+      b >>= 1;
+    }
+  }
+  datagram[7] = crc;
+
+  const uint8_t     mask = hal_tbl_lookup(m_pinout.uart, IO_BIT);
+  volatile uint8_t *port = (volatile uint8_t *)(hal_tbl_lookup(m_pinout.uart, IO_DATA));
+
+  for(uint8_t i = 0; i < sizeof(datagram); i++) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      // start bit, 8 data bits LSB first and the stop bit
+      uint16_t frame = ((uint16_t) datagram[i] << 1) | 0x200;
+      for(uint8_t j = 0; j < 10; j++) {
+        if(frame & 0x01) { *port |= mask; } else { *port &= ~mask; }
+        frame >>= 1;
+        _delay_us(TMC2209_UART_BIT_US);
+      }
+    }
+  }
+}
+
+
+/**
+ * @brief Set the microstepping resolution
+ * @details StallGuard only drives DIAG while TSTEP is below TCOOLTHRS, i.e.
+ * above TMC2209_STALL_MIN_SPEED. At lower speeds, and on the first steps from
+ * standstill where TSTEP is still at its maximum, SG_RESULT is meaningless and
+ * would abort moves with false stalls. TSTEP is measured in 1/256 steps thus
+ * the threshold follows the resolution.
+ *
+ */
+void tmc2209::set_mres(const uint8_t& mres)
+{
+  uint32_t tcoolthrs = 0;
+
+  if(m_config.stall) {
+    tcoolthrs = TMC2209_FCLK / ((uint32_t) TMC2209_STALL_MIN_SPEED << mres);
+    if(tcoolthrs > 0xFFFFF) { tcoolthrs = 0xFFFFF; }
+  }
+
+  write_reg(TMC2209_TCOOLTHRS, tcoolthrs);
+  write_reg(TMC2209_CHOPCONF, TMC2209_CHOPCONF_VAL | ((uint32_t) mres << 24));
+}
+
+
+/**
+ * @brief [brief description]
+ * @details [long description]
+ *
+ */
+void tmc2209::halt()
+{
+  stepper::halt();
+  m_homing = false;
+  m_sleep_timeout_cnt = ((m_sleep_timeout * 1000000UL) / TIMER0_TICK);
+  IO::write(m_pinout.step, LOW);
+}
+
+
+/**
+ * @brief Set microstepping resolution: Full step
+ *
+ */
+void tmc2209::set_full_step()
+{
+  m_mode = 0x00;
+  set_mres(8);
+}
+
+
+/**
+ * @brief Set microstepping resolution: half step
+ *
+ */
+void tmc2209::set_half_step()
+{
+  m_mode = 0xFF;
+  set_mres(7);
+}
+
+
+/**
+ * @brief Set microstepping resolution: quarter step
+ *
+ */
+void tmc2209::set_quarter_step()
+{
+  m_mode = 0xFF;
+  set_mres(6);
+}
+
+
+/**
+ * @brief Seek the inner end of travel using StallGuard
+ * @details The motor is sent inwards from the far end of the position range
+ * and the position is zeroed where it stalls. Returns false when stall
+ * detection is disabled.
+ *
+ */
+bool tmc2209::home()
+{
+  if(! m_config.stall) { return false; }
+
+  #ifdef HIGH_RESOLUTION_MODE
+    set_current_position(0x7FFFFFFFUL);
+  #else
+    set_current_position(0xFFFF);
+  #endif
+
+  set_target_position(0);
+
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    m_homing = true;
+    move();
+  }
+
+  return true;
+}
+
+// Disable 'implicit fall-through' warning, as the switch statements fall-through on purpose.
+#pragma GCC diagnostic ignored "-Wimplicit-fallthrough="
+
+/**
+ * @brief [brief description]
+ * @details [long description]
+ *
+ */
+bool tmc2209::step_cw()
+{
+  switch(IO::read(m_pinout.direction))
+  {
+    case LOW:
+      IO::write(m_pinout.direction, HIGH);
+      // TMC2209: 20ns
+      util::delay_250ns();
+
+    case HIGH:
+      ;
+
+    default:
+      return step();
+  }
+}
+
+
+/**
+ * @brief [brief description]
+ * @details [long description]
+ *
+ */
+bool tmc2209::step_ccw()
+{
+  switch(IO::read(m_pinout.direction))
+  {
+    case LOW:
+      ;
+
+    case HIGH:
+      IO::write(m_pinout.direction, LOW);
+      // TMC2209: 20ns
+      util::delay_250ns();
+
+    default:
+      return step();
+  }
+}
+// Restore warnings to command line parameters.
+#pragma GCC diagnostic pop
+
+
+/**
+ * @brief Move the stepper motor one step.
+ * @details Writes a pulse on the output pin. When StallGuard flags a stall
+ * on the DIAG pin the move is stopped and the step is not counted, when
+ * homing the stall point becomes the zero position.
+ *
+ */
+bool tmc2209::step()
+{
+  if(IO::read(m_pinout.enable)) {
+    IO::write(m_pinout.enable, LOW);
+  }
+
+  if(m_config.stall && IO::read(m_pinout.diag)) {
+    if(m_homing) { m_position.current = 0; }
+    else if(m_stalls < UINT16_MAX) { ++m_stalls; }
+
+    halt();
+    return false;
+  }
+
+  // TMC2209: 100ns
+  IO::write(m_pinout.step, HIGH);
+  util::delay_1us();
+  IO::write(m_pinout.step, LOW);
+
+  return true;
+}
+
+
+/**
+ * @brief [brief description]
+ * @details [long description]
+ *
+ */
+void tmc2209::sleep()
+{
+  if(m_sleep_when_idle && m_sleep_timeout_cnt) {
+    --m_sleep_timeout_cnt;
+
+    if(!m_sleep_timeout_cnt) { power_down(); }
+  }
+}
+
+
+/**
+ * @brief Cut the motor current immediately
+ * @details Disables the driver output stage, the next step() call will
+ * enable it again.
+ *
+ */
+void tmc2209::power_down()
+{
+  m_sleep_timeout_cnt = 0;
+  IO::write(m_pinout.enable, HIGH);
+}
+
+#endif
@@ -0,0 +1,102 @@
+/**
+ * Ardufocus - Moonlite compatible focuser
+ * Copyright (C) 2017-2019 João Brázio [joao@brazio.org]
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __TMC2209_H__
+#define __TMC2209_H__
+
+#include "config.h"
+
+#include "stepper.h"
+#include "macro.h"
+#include "utility.h"
+
+class tmc2209: public stepper
+{
+  public:
+    struct pinout_t
+    {
+      pin_t enable, step, direction;
+      pin_t uart, diag;
+    };
+
+    struct config_t
+    {
+      uint8_t  address;     // UART node address (MS1, MS2 straps)
+      uint16_t current;     // Run current (mA RMS)
+      uint16_t microsteps;  // Full step = 1 .. 256
+      uint8_t  stall;       // StallGuard threshold, 0 disables it
+    };
+
+    /*
+     *
+     *   TMC2209 STEP STICK PINOUT
+     *
+     *       .-----------.
+     * !ENA |o           o| VMOT
+     *  MS1 |o  -----    o| GND
+     *  MS2 |o |     |   o| 2B
+     *  SPR |o |     |   o| 2A
+     *  PDN |o  -----    o| 1A
+     *  CLK |o      ---  o| 1B
+     *  STP |o     | O | o| VDD
+     *  DIR |o      ---  o| GND
+     *       `-----------´
+     *
+     * ENA: Enable (negated logic), drives the motor current like !SLP on the A4988
+     * MS1,MS2: UART node address when the UART is used
+     * PDN: Single wire UART, connect to the uart pin through a 1K resistor
+     * DIAG: Pulses high on a StallGuard event (on the side of the board)
+     */
+
+  protected:
+    const pinout_t m_pinout;
+    const config_t m_config;
+
+    volatile bool m_homing = false;  // Seeking the home position
+    volatile uint16_t m_stalls = 0;  // Stall events since boot
+
+  private:
+    force_inline speed bool step();
+
+    void write_reg(const uint8_t&, const uint32_t&);
+    void set_mres(const uint8_t&);
+
+  public:
+    virtual void init();
+    virtual void halt();
+    virtual void sleep();
+    virtual void power_down();
+    virtual void set_full_step();
+    virtual void set_half_step();
+    virtual void set_quarter_step();
+    virtual speed bool step_cw();
+    virtual speed bool step_ccw();
+    virtual bool home();
+
+    inline uint16_t get_stalls() {
+      uint16_t n;
+      ATOMIC_BLOCK(ATOMIC_RESTORESTATE) { n = m_stalls; }
+      return n;
+    }
+
+    inline tmc2209(pinout_t const& pinout, config_t const& config)
+      : m_pinout({ pinout }), m_config({ config }) { ; }
+};
+
+#endif
@@ -24,6 +24,28 @@
 motor_t Keybd::motor = MOTOR_ONE;
 bool Keybd::inited = false;
 
+volatile uint8_t  Keybd::s_raw = 0;
+volatile uint8_t  Keybd::s_pending = 0;
+volatile uint16_t Keybd::s_edge[BUTTON_COUNT] = { 0 };
+uint8_t Keybd::s_state = 0;
+
+/**
+ * @brief Pin change interrupt handlers
+ * @details The buttons may be spread over any of the ports.
+ *
+ */
+ISR(PCINT0_vect)
+{
+  Keybd::isr();
+}
+
+ISR(PCINT1_vect, ISR_ALIASOF(PCINT0_vect));
+ISR(PCINT2_vect, ISR_ALIASOF(PCINT0_vect));
+
+#ifdef PCIE3
+ISR(PCINT3_vect, ISR_ALIASOF(PCINT0_vect));
+#endif
+
 void Keybd::setup()
 {
   if(inited) { return; }
@@ -59,30 +81,114 @@ void Keybd::setup()
     IO::set_as_output(UI_KAP_MOTOR_BUTTON_LED_PIN);
     IO::write(UI_KAP_MOTOR_BUTTON_LED_PIN, LOW);
   #endif
+
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    // A button held during boot is not a press
+    s_raw   = sample();
+    s_state = s_raw;
+
+    pcint_enable(UI_KAP_FWD_BUTTON_PIN);
+    pcint_enable(UI_KAP_BWD_BUTTON_PIN);
+
+    #if defined(UI_KAP_SWT_BUTTON_PIN) && defined(MOTOR2_HAS_DRIVER)
+      pcint_enable(UI_KAP_SWT_BUTTON_PIN);
+    #endif
+  }
+
+  #if defined(UI_KAP_SWT_BUTTON_PIN) && defined(MOTOR2_HAS_DRIVER) && defined(UI_KAP_MOTOR_BUTTON_LED_PIN)
+    IO::write(UI_KAP_MOTOR_BUTTON_LED_PIN, HIGH);
+  #endif
 }
 
-void Keybd::tick()
+/**
+ * @brief Enable the pin change interrupt of a pin
+ *
+ */
+void Keybd::pcint_enable(const uint8_t& pin)
 {
-  setup();
+  const uint8_t mask = hal_tbl_lookup(pin, IO_BIT);
+  volatile uint8_t *port = (volatile uint8_t *)(hal_tbl_lookup(pin, IO_DATA));
+
+  if(port == &PORTB)      { PCMSK0 |= mask; PCICR |= bit(PCIE0); }
+  else if(port == &PORTC) { PCMSK1 |= mask; PCICR |= bit(PCIE1); }
+  else if(port == &PORTD) { PCMSK2 |= mask; PCICR |= bit(PCIE2); }
+  #ifdef PCIE3
+  else if(port == &PORTE) { PCMSK3 |= mask; PCICR |= bit(PCIE3); }
+  #endif
+}
+
+/**
+ * @brief Pressed buttons, one bit per button_t
+ *
+ */
+uint8_t Keybd::sample()
+{
+  uint8_t pressed = 0;
 
-  // Get button state
-  bool button_fwd_state = (bool)(IO::read(UI_KAP_FWD_BUTTON_PIN) == LOW); // fwd
-  bool button_bwd_state = (bool)(IO::read(UI_KAP_BWD_BUTTON_PIN) == LOW); // back
+  if(IO::read(UI_KAP_FWD_BUTTON_PIN) == LOW) { pressed |= bit(BUTTON_FWD); }
+  if(IO::read(UI_KAP_BWD_BUTTON_PIN) == LOW) { pressed |= bit(BUTTON_BWD); }
+
+  #ifdef UI_KAP_SWT_BUTTON_PIN
+  if(IO::read(UI_KAP_SWT_BUTTON_PIN) == LOW) { pressed |= bit(BUTTON_SWT); }
+  #endif
 
   #ifdef UI_KAP_INVERT_BUTTON_LOGIC
-    button_fwd_state ^= true;
-    button_bwd_state ^= true;
+    pressed ^= bit(BUTTON_FWD) | bit(BUTTON_BWD) | bit(BUTTON_SWT);
   #endif
 
-  static uint8_t counter[3] = { 0 };
-  static bool previous_state[3] = { false };
+  return pressed;
+}
+
+/**
+ * @brief Time stamp the edges, called from the pin change interrupt
+ * @details Every bounce pushes the time stamp forward thus a state is only
+ *          accepted once the contact has settled.
+ *
+ */
+void Keybd::isr()
+{
+  const uint8_t now = sample();
+  const uint8_t changed = now ^ s_raw;
+  if(! changed) { return; }
+
+  const uint16_t t = g_uptime_ms;
+  for(uint8_t i = 0; i < BUTTON_COUNT; i++) {
+    if(changed & bit(i)) { s_edge[i] = t; }
+  }
+
+  s_raw = now;
+  s_pending |= changed;
+}
+
+void Keybd::tick()
+{
+  setup();
 
   // Debounce routine
-  bool button_fwd_trigger = false;
-  debounce(button_fwd_state, previous_state[0], button_fwd_trigger, counter[0], UI_KAP_BUTTON_DEBOUNCE);
+  uint8_t trigger = 0;
 
-  bool button_bwd_trigger = false;
-  debounce(button_bwd_state, previous_state[1], button_bwd_trigger, counter[1], UI_KAP_BUTTON_DEBOUNCE);
+  if(s_pending) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      const uint16_t t = g_uptime_ms;
+
+      for(uint8_t i = 0; i < BUTTON_COUNT; i++) {
+        if(! (s_pending & bit(i))) { continue; }
+        if((uint16_t)(t - s_edge[i]) < UI_KAP_DEBOUNCE_MS) { continue; }
+
+        s_pending &= ~bit(i);
+        if((s_raw ^ s_state) & bit(i)) {
+          s_state ^= bit(i);
+          trigger |= bit(i);
+        }
+      }
+    }
+  }
+
+  const bool button_fwd_state = s_state & bit(BUTTON_FWD);
+  const bool button_bwd_state = s_state & bit(BUTTON_BWD);
+
+  // Nothing to do while idle
+  if(! trigger && ! button_fwd_state && ! button_bwd_state) { return; }
 
   // Visual feedback when the forward button is pressed
   #ifdef UI_KAP_FWD_BUTTON_LED_PIN
@@ -99,6 +205,9 @@ void Keybd::tick()
   // Invalid state when two buttons are pushed at the same time
   if(button_fwd_state && button_bwd_state) { return; }
 
+  const bool button_fwd_trigger = trigger & bit(BUTTON_FWD);
+  const bool button_bwd_trigger = trigger & bit(BUTTON_BWD);
+
   if(button_fwd_state || button_bwd_state) {
     if(button_fwd_trigger || button_bwd_trigger) {
       old_motor_speed = api::motor_get_speed(motor);
@@ -121,20 +230,7 @@ void Keybd::tick()
     }
 
     #if defined(UI_KAP_SWT_BUTTON_PIN) && defined(MOTOR2_HAS_DRIVER)
-      bool button_swt_state = (bool)(IO::read(UI_KAP_SWT_BUTTON_PIN) == LOW); // motor switch
-
-      #ifdef UI_KAP_INVERT_BUTTON_LOGIC
-      button_swt_state ^= true;
-      #endif
-
-      bool button_swt_trigger = false;
-      debounce(button_swt_state, previous_state[2], button_swt_trigger, counter[2], UI_KAP_BUTTON_DEBOUNCE);
-
-      #ifdef UI_KAP_MOTOR_BUTTON_LED_PIN
-      IO::write(UI_KAP_MOTOR_BUTTON_LED_PIN, (motor == MOTOR_ONE) ? HIGH : LOW);
-      #endif
-
-      if(button_swt_state && button_swt_trigger) {
+      if((s_state & trigger) & bit(BUTTON_SWT)) {
         if(! api::motor_is_moving(motor)) {
           switch(motor) {
             case MOTOR_ONE:
@@ -149,30 +245,11 @@ void Keybd::tick()
           }
         }
       }
-    #endif
-  }
-}
 
-void Keybd::debounce(bool& current_state, bool& previous_state, bool& trigger_event, uint8_t& counter, const uint8_t& threshold)
-{
-  setup();
-
-  if(current_state == previous_state) {
-    trigger_event = false;
-    counter = 0;
-    return;
-  }
-
-  if(counter < threshold) {
-    current_state = previous_state;
-    trigger_event = false;
-    ++counter;
-    return;
+      #ifdef UI_KAP_MOTOR_BUTTON_LED_PIN
+      IO::write(UI_KAP_MOTOR_BUTTON_LED_PIN, (motor == MOTOR_ONE) ? HIGH : LOW);
+      #endif
+    #endif
   }
-
-  previous_state = current_state;
-  trigger_event = true;
-  counter = 0;
-  return;
 }
 #endif
@@ -24,7 +24,15 @@
 #include "analog.h"
 #include "api.h"
 #include "io.h"
+#include "uptime.h"
 
+/**
+ * @brief   Basic two (or three) button keypad
+ * @details Button edges are captured by pin change interrupts and time
+ *          stamped against the millisecond uptime clock, a button state is
+ *          only accepted after being stable for UI_KAP_DEBOUNCE_MS. While no
+ *          button is pressed or bouncing tick() returns right away.
+ */
 class Keybd
 {
   /**
@@ -37,14 +45,29 @@ class Keybd
 
     typedef void (*callback_t)(const bool&);
 
+    enum button_t {
+      BUTTON_FWD,
+      BUTTON_BWD,
+      BUTTON_SWT,
+      BUTTON_COUNT
+    };
+
   private:
     static motor_t motor;
     static bool inited;
 
+    static volatile uint8_t  s_raw;                 // Last sampled level
+    static volatile uint8_t  s_pending;             // Edges not yet debounced
+    static volatile uint16_t s_edge[BUTTON_COUNT];  // Time of the last edge
+    static uint8_t s_state;                         // Debounced state
+
+    static void pcint_enable(const uint8_t&);
+    static uint8_t sample();
+
   public:
     static void setup();
     static void tick();
-    static void debounce(bool&, bool&, bool&, uint8_t&, const uint8_t& );
+    static void isr();
 
   public:
     static callback_t event_fwd_pressed();
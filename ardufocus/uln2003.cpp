@@ -50,8 +50,14 @@ void uln2003::init()
 {
   stepper::init();
 
+  m_mode = 0x00;
   m_sequence = 0;
-  set_full_step();
+
+  #ifdef USE_ULN2003_ADAPTIVE_DRIVE
+    set_half_step();
+  #else
+    set_full_step();
+  #endif
 
   IO::set_as_output(m_pinout.A);
   IO::set_as_output(m_pinout.B);
@@ -78,28 +84,53 @@ void uln2003::halt()
 
 
 /**
- * @brief [brief description]
- * @details [long description]
+ * @brief Switch to the two-phase full step table
+ * @details The two coil entries of the half step table are the full step
+ *          table shifted by one. From a single coil entry there is no full
+ *          step match, one half step is taken first onto the next two coil
+ *          entry and counted on the position, the rotor then stays where it
+ *          is across the swap.
  *
  */
 void uln2003::set_full_step()
 {
-  m_mode         = 0x00;
-  m_stepping_sz  = lookup::uln2003_unipolar_full_sz;
-  p_stepping_tbl = lookup::uln2003_unipolar_full;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    if(m_mode && !(m_sequence & 0x01)) {
+      // Forward on the table unless that would take the position below zero
+      int8_t dir = (m_invert_direction) ? -1 : 1;
+      const int8_t seq = (dir < 0 && ! m_position.current) ? -1 : 1;
+      if(seq < 0) { dir = 1; }
+
+      m_sequence = (m_sequence + seq) & (m_stepping_sz - 1);
+      step();
+
+      m_position.current += dir;
+      if(! m_position.moving) { m_position.target = m_position.current; }
+    }
+
+    if(m_mode) { m_sequence = ((m_sequence + 1) >> 1) & 0x03; }
+
+    m_mode         = 0x00;
+    m_stepping_sz  = lookup::uln2003_unipolar_full_sz;
+    p_stepping_tbl = lookup::uln2003_unipolar_full;
+  }
 }
 
 
 /**
- * @brief [brief description]
- * @details [long description]
+ * @brief Switch to the half step table
+ * @details Counterpart of set_full_step(), the energized coils do not change.
  *
  */
 void uln2003::set_half_step()
 {
-  m_mode         = 0xFF;
-  m_stepping_sz  = lookup::uln2003_unipolar_half_sz;
-  p_stepping_tbl = lookup::uln2003_unipolar_half;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    if(! m_mode) { m_sequence = ((m_sequence << 1) + 7) & 0x07; }
+
+    m_mode         = 0xFF;
+    m_stepping_sz  = lookup::uln2003_unipolar_half_sz;
+    p_stepping_tbl = lookup::uln2003_unipolar_half;
+  }
 }
 
 
@@ -110,9 +141,7 @@ void uln2003::set_half_step()
  */
 bool uln2003::step_cw()
 {
-  step();
-  --m_sequence;
-  if (m_sequence < 0) { m_sequence = (m_stepping_sz -1); }
+  advance(-1);
   return true;
 }
 
@@ -124,13 +153,64 @@ bool uln2003::step_cw()
  */
 bool uln2003::step_ccw()
 {
-  step();
-  ++m_sequence;
-  if (m_sequence > (int8_t) (m_stepping_sz -1)) { m_sequence = 0; }
+  advance(1);
   return true;
 }
 
 
+/**
+ * @brief Move along the stepping table and energize the new entry
+ * @details m_sequence always points to the energized entry, a reversal
+ *          steps back to the previous one. Both tables have a power of two
+ *          size thus wrapping is a mask.
+ *
+ */
+void uln2003::advance(const int8_t& direction)
+{
+  #ifdef USE_ULN2003_ADAPTIVE_DRIVE
+    m_step_units = (m_mode) ? stride() : 1;
+  #endif
+
+  m_sequence = (m_sequence + direction * (int8_t) m_step_units) & (m_stepping_sz - 1);
+  step();
+}
+
+
+#ifdef USE_ULN2003_ADAPTIVE_DRIVE
+  /**
+   * @brief Half steps to take on the next step
+   * @details
+   * The position is always counted in half steps. Above the switch speed the
+   * odd, two coil, entries of the half step table are walked two at a time
+   * which is the two-phase full step drive, from an even, single coil, entry
+   * one half step is taken first thus the switch always happens at a matching
+   * phase. The last half step of an odd length move is never skipped and the
+   * switch back uses a 25% hysteresis. The rates are in half steps/sec, a
+   * full step is followed by twice the tick interval thus the shaft speed
+   * does not jump at the switch.
+   *
+   */
+  uint8_t uln2003::stride()
+  {
+    // The Moonlite speed value divides the step rate
+    const uint16_t f = step_freq();
+    const uint32_t div = m_speed >> 1;
+
+    if(m_fast) {
+      if(f < (ULN2003_FULL_STEP_SPEED - (ULN2003_FULL_STEP_SPEED >> 2)) * div) { m_fast = false; }
+    } else if(f >= ULN2003_FULL_STEP_SPEED * div) { m_fast = true; }
+
+    if(! m_fast || !(m_sequence & 0x01)) { return 1; }
+
+    const uint32_t left = (m_position.target > m_position.current)
+      ? m_position.target - m_position.current
+      : m_position.current - m_position.target;
+
+    return (left > 1) ? 2 : 1;
+  }
+#endif
+
+
 /**
  * @brief [brief description]
  * @details [long description]
@@ -159,13 +239,25 @@ void uln2003::sleep()
   if(m_sleep_when_idle && m_sleep_timeout_cnt) {
     --m_sleep_timeout_cnt;
 
-    if(!m_sleep_timeout_cnt) {
-      ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
-        IO::write(m_pinout.A, LOW);
-        IO::write(m_pinout.B, LOW);
-        IO::write(m_pinout.C, LOW);
-        IO::write(m_pinout.D, LOW);
-      }
-    }
+    if(!m_sleep_timeout_cnt) { power_down(); }
+  }
+}
+
+
+/**
+ * @brief Cut the motor current immediately
+ * @details De-energizes all the coils without waiting for the sleep timeout,
+ * the next step() call will energize them again.
+ *
+ */
+void uln2003::power_down()
+{
+  m_sleep_timeout_cnt = 0;
+
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    IO::write(m_pinout.A, LOW);
+    IO::write(m_pinout.B, LOW);
+    IO::write(m_pinout.C, LOW);
+    IO::write(m_pinout.D, LOW);
   }
 }
@@ -41,13 +41,23 @@ class uln2003: public stepper
              uint8_t m_stepping_sz;
     const    uint8_t *p_stepping_tbl;
 
+    #ifdef USE_ULN2003_ADAPTIVE_DRIVE
+    bool m_fast = false;             // Running on two-phase full steps
+    #endif
+
   private:
     void speed step();
+    inline speed void advance(const int8_t&);
+
+    #ifdef USE_ULN2003_ADAPTIVE_DRIVE
+    inline speed uint8_t stride();
+    #endif
 
   public:
     virtual void init();
     virtual void halt();
     virtual void sleep();
+    virtual void power_down();
     virtual void set_full_step();
     virtual void set_half_step();
     virtual speed bool step_cw();
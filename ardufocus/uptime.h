@@ -0,0 +1,78 @@
+/**
+ * Ardufocus - Moonlite compatible focuser
+ * Copyright (C) 2017-2019 João Brázio [joao@brazio.org]
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef __UPTIME_H__
+#define __UPTIME_H__
+
+#include "config.h"
+
+#include <stdint.h>
+#include <avr/io.h>
+#include <util/atomic.h>
+
+// Duration of one Timer2 count
+#define TIMER2_COUNT_US (TIMER2_PSCL / (F_CPU / 1000000L))
+
+// Milliseconds since boot, updated by the Timer2 ISR
+extern volatile uint32_t g_uptime_ms;
+
+// Host clock minus uptime_us(), set by clock_sync()
+extern uint32_t g_clock_offset;
+
+inline uint32_t uptime_ms() {
+  uint32_t ms;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) { ms = g_uptime_ms; }
+  return ms;
+}
+
+/**
+ * @brief   Microseconds since boot, wraps every ~71 minutes
+ * @details A compare match which is still pending means the counter already
+ *          wrapped but the millisecond count was not updated yet.
+ */
+inline uint32_t uptime_us() {
+  uint32_t ms;
+  uint8_t cnt;
+
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    ms  = g_uptime_ms;
+    cnt = TCNT2;
+
+    if(bit_is_set(TIFR2, OCF2A)) {
+      ++ms;
+      cnt = TCNT2;
+    }
+  }
+
+  return (ms * 1000L) + ((uint32_t) cnt * TIMER2_COUNT_US);
+}
+
+/**
+ * @brief   Device clock in microseconds, aligned to the host by clock_sync()
+ * @details Runs from uptime_us() thus it has the same resolution and wraps
+ *          at the same rate, the host is expected to unwrap it.
+ */
+inline uint32_t clock_us() {
+  return uptime_us() + g_clock_offset;
+}
+
+inline void clock_sync(const uint32_t& us) {
+  g_clock_offset = us - uptime_us();
+}
+
+#endif
@@ -36,99 +36,28 @@ namespace util
   inline uint16_t  hex2l(const char* str) { return ( strtol(str, NULL, 16)); }
   inline uint32_t hex2ul(const char* str) { return (strtoul(str, NULL, 16)); }
 
-  __attribute__((always_inline)) inline void delay_250ns()
-  {
-    // Delay 4 cycles: 250us at 16 MHz
-    asm volatile (
-      "    rjmp 1f" "\n"
-      "1:  rjmp 2f" "\n"
-      "2:"  "\n"
-    );
+  /**
+   * @brief   CPU cycles needed to wait at least the given time
+   * @details Rounded up, a delay is never shorter than requested whatever the
+   *          F_CPU value, and never zero.
+   */
+  constexpr uint32_t ns2cycles(const uint32_t ns) {
+    return (ns == 0) ? 1 : (uint32_t)
+      (((uint64_t) ns * (F_CPU / 1000L) + 999999UL) / 1000000UL);
   }
 
-  __attribute__((always_inline)) inline void delay_500ns()
-  {
-    // Delay 8 cycles: 500us at 16 MHz
-    asm volatile (
-      "    lpm" "\n"
-      "    lpm" "\n"
-      "    rjmp 1f" "\n"
-      "1:"  "\n"
-    );
+  /**
+   * @brief   Cycle exact busy wait, generated at compile time from F_CPU
+   * @details The cycle count is a template argument thus the compiler emits
+   *          the shortest instruction sequence for it, without any call or
+   *          loop setup overhead.
+   */
+  template<uint32_t NS> force_inline void delay_ns() {
+    __builtin_avr_delay_cycles(ns2cycles(NS));
   }
 
-  __attribute__((always_inline)) inline void delay_750ns()
-  {
-    // Delay 12 cycles: 750us at 16 MHz
-    asm volatile (
-      "    ldi  r18, 4" "\n"
-      "1:  dec  r18"  "\n"
-      "    brne 1b" "\n"
-    );
-  }
-
-  __attribute__((always_inline)) inline void delay_1us()
-  {
-    // Delay 16 cycles: 1us at 16 MHz
-    asm volatile (
-      "    ldi  r18, 5" "\n"
-      "1:  dec  r18"    "\n"
-      "    brne 1b"     "\n"
-      "    nop"         "\n"
-    );
-  }
-
-  __attribute__((always_inline)) inline void delay_2us()
-  {
-    // Delay 32 cycles: 2us at 16 MHz
-    asm volatile (
-      "    ldi  r18, 10"  "\n"
-      "1:  dec  r18"      "\n"
-      "    brne 1b"       "\n"
-      "    rjmp 1f"       "\n"
-      "1:"                "\n"
-    );
-  }
-
-  __attribute__((always_inline)) inline void delay_1ms()
-  {
-    // Delay 16 000 cycles: 1ms at 16.0 MHz
-    asm volatile (
-      "    ldi  r18, 21"  "\n"
-      "    ldi  r19, 199" "\n"
-      "1:  dec  r19"      "\n"
-      "    brne 1b"       "\n"
-      "    dec  r18"      "\n"
-      "    brne 1b"       "\n"
-    );
-  }
-
-  __attribute__((always_inline)) inline void delay_2ms()
-  {
-    // Delay 32 000 cycles: 2ms at 16.0 MHz
-    asm volatile (
-      "    ldi  r18, 42"  "\n"
-      "    ldi  r19, 142" "\n"
-      "1:  dec  r19"  "\n"
-      "    brne 1b" "\n"
-      "    dec  r18"  "\n"
-      "    brne 1b" "\n"
-      "    nop" "\n"
-    );
-  }
-
-  __attribute__((always_inline)) inline void delay_5ms()
-  {
-    // Delay 80 000 cycles: 5ms at 16.0 MHz
-    asm volatile (
-      "    ldi  r18, 104" "\n"
-      "    ldi  r19, 229" "\n"
-      "1:  dec  r19"      "\n"
-      "    brne 1b"       "\n"
-      "    dec  r18"      "\n"
-      "    brne 1b"       "\n"
-    );
-  }
+  force_inline void delay_250ns() { delay_ns<250>();      }
+  force_inline void delay_1us()   { delay_ns<1000>();     }
 
   #ifdef HAS_ACCELERATION
     float  lerp(float const&, float const&, float);
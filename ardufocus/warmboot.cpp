@@ -0,0 +1,150 @@
+/**
+ * Ardufocus - Moonlite compatible focuser
+ * Copyright (C) 2017-2019 João Brázio [joao@brazio.org]
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include "warmboot.h"
+
+#ifdef USE_WARM_RESTART
+
+#include <string.h>
+#include <avr/io.h>
+#include <avr/wdt.h>
+#include <util/atomic.h>
+#include <util/crc16.h>
+#include "api.h"
+#include "isr.h"
+
+// Neither of these is touched by the C runtime init
+static warmboot_t s_image      __attribute__((section(".noinit")));
+static uint8_t    s_reset_flags __attribute__((section(".noinit")));
+
+/**
+ * @brief   Capture the reset cause before anything else runs
+ * @details After a watchdog reset the watchdog stays enabled with the
+ *          shortest timeout, thus it must be disabled before the C runtime
+ *          init. Optiboot clears MCUSR and hands it over on r2 instead.
+ *
+ */
+void warmboot_early() __attribute__((naked, used, section(".init3")));
+void warmboot_early()
+{
+  uint8_t flags = MCUSR;
+  if(! flags) { asm volatile("mov %0, r2" : "=r" (flags)); }
+
+  MCUSR = 0;
+  wdt_disable();
+  s_reset_flags = flags;
+}
+
+static uint16_t warmboot_crc(const warmboot_t* image)
+{
+  uint16_t crc = 0xFFFF;
+  const uint8_t* p = (const uint8_t*) image;
+  for(uint8_t i = 0; i < offsetof(warmboot_t, crc); i++) { crc = _crc16_update(crc, p[i]); }
+  return crc;
+}
+
+static void warmboot_snapshot(warmboot_motor_t* m, stepper* drv)
+{
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    m->position = drv->get_current_position();
+    m->target   = drv->get_target_position();
+    m->moving   = drv->is_moving();
+  }
+
+  m->step_speed = drv->get_speed();
+  m->mode_cmd   = drv->get_mode_cmd();
+}
+
+/**
+ * @brief   Restore the state of one motor
+ * @details The stepping mode is restored by replaying the command which set
+ *          it, the same mapping ":SF#", ":SH#" and ":SQ#" go through, thus
+ *          the position is put back on the scale it was counted in.
+ *
+ */
+static void warmboot_apply(const warmboot_motor_t* m, stepper* drv, const motor_t& idx)
+{
+  switch(m->mode_cmd) {
+    case MODE_CMD_FULL:    api::motor_set_mode_full(idx);    break;
+    case MODE_CMD_HALF:    api::motor_set_mode_half(idx);    break;
+    case MODE_CMD_QUARTER: api::motor_set_mode_quarter(idx); break;
+    default: break;
+  }
+
+  drv->set_speed(m->step_speed);
+  drv->set_current_position(m->position);
+  drv->set_target_position(m->target);
+  if(m->moving) { drv->move(); }
+}
+
+uint8_t warmboot_reset_flags()
+{
+  return s_reset_flags;
+}
+
+/**
+ * @brief   Refresh the RAM mirror, called on every main loop pass
+ * @details The CRC is only computed when something changed. A reset while
+ *          the mirror is being written leaves it with a bad CRC, thus the
+ *          EEPROM copy is used instead.
+ *
+ */
+void warmboot_save()
+{
+  warmboot_t image;
+  memset(&image, 0, sizeof(image));
+  image.header = WARMBOOT_MAGIC_HEADER;
+
+  #ifdef MOTOR1_HAS_DRIVER
+    warmboot_snapshot(&image.motor[0], g_motor1);
+  #endif
+
+  #ifdef MOTOR2_HAS_DRIVER
+    warmboot_snapshot(&image.motor[1], g_motor2);
+  #endif
+
+  if(! memcmp(&image, &s_image, offsetof(warmboot_t, crc))) { return; }
+
+  image.crc = warmboot_crc(&image);
+  memcpy(&s_image, &image, sizeof(image));
+}
+
+/**
+ * @brief   Restore the motor state after a warm reset
+ * @details Must be called after the motors are initialized, returns false
+ *          after a power-on or when the mirror is not valid.
+ *
+ */
+bool warmboot_load()
+{
+  if(s_reset_flags & bit(PORF)) { return false; }
+  if(s_image.header != WARMBOOT_MAGIC_HEADER) { return false; }
+  if(s_image.crc != warmboot_crc(&s_image)) { return false; }
+
+  #ifdef MOTOR1_HAS_DRIVER
+    warmboot_apply(&s_image.motor[0], g_motor1, MOTOR_ONE);
+  #endif
+
+  #ifdef MOTOR2_HAS_DRIVER
+    warmboot_apply(&s_image.motor[1], g_motor2, MOTOR_TWO);
+  #endif
+
+  return true;
+}
+
+#endif
@@ -0,0 +1,52 @@
+/**
+ * Ardufocus - Moonlite compatible focuser
+ * Copyright (C) 2017-2019 João Brázio [joao@brazio.org]
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef __WARMBOOT_H__
+#define __WARMBOOT_H__
+
+#include "config.h"
+
+#include <stdint.h>
+
+#define WARMBOOT_MAGIC_HEADER 0x5aa6
+
+struct warmboot_motor_t {
+  uint32_t position;
+  uint32_t target;
+  uint16_t step_speed;
+  uint8_t  mode_cmd;    // mode_cmd_t, replayed through the api
+  bool     moving;
+};
+
+struct warmboot_t {
+  uint16_t header;
+  warmboot_motor_t motor[2];
+  uint16_t crc;
+};
+
+#ifdef USE_WARM_RESTART
+  uint8_t warmboot_reset_flags();
+  void warmboot_save();
+  bool warmboot_load();
+#else
+  inline uint8_t warmboot_reset_flags() { return 0; }
+  inline void warmboot_save() { ; }
+  inline bool warmboot_load() { return false; }
+#endif
+
+#endif
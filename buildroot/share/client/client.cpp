@@ -0,0 +1,419 @@
+/**
+ * Ardufocus - Moonlite compatible focuser
+ * Copyright (C) 2017-2019 João Brázio [joao@brazio.org]
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "client.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+namespace ardufocus {
+
+  /**
+   * @brief Open and configure the serial device
+   * @details Raw mode, 8 data bits, no parity, 1 stop bit
+   *
+   */
+  serial_transport::serial_transport(const std::string& device, uint32_t baudrate)
+  {
+    m_fd = ::open(device.c_str(), O_RDWR | O_NOCTTY);
+    if(m_fd < 0) { throw std::runtime_error("unable to open " + device); }
+
+    speed_t speed;
+    switch(baudrate) {
+      case 9600:   speed = B9600;   break;
+      case 19200:  speed = B19200;  break;
+      case 38400:  speed = B38400;  break;
+      case 57600:  speed = B57600;  break;
+      case 115200: speed = B115200; break;
+      default:
+        ::close(m_fd);
+        throw std::runtime_error("unsupported baudrate");
+    }
+
+    struct termios tio;
+    tcgetattr(m_fd, &tio);
+    cfmakeraw(&tio);
+    cfsetispeed(&tio, speed);
+    cfsetospeed(&tio, speed);
+    tio.c_cflag |= (CLOCAL | CREAD);
+    tio.c_cflag &= ~(CSTOPB | PARENB);
+    tcsetattr(m_fd, TCSANOW, &tio);
+    tcflush(m_fd, TCIOFLUSH);
+  }
+
+  serial_transport::~serial_transport()
+  {
+    ::close(m_fd);
+  }
+
+  void serial_transport::write(const std::string& data)
+  {
+    size_t n = 0;
+    while(n < data.size()) {
+      const ssize_t r = ::write(m_fd, data.data() + n, data.size() - n);
+      if(r < 0) { throw std::runtime_error("serial write failed"); }
+      n += r;
+    }
+  }
+
+  size_t serial_transport::read(char* buf, size_t sz, int timeout_ms)
+  {
+    struct pollfd p = { m_fd, POLLIN, 0 };
+    if(::poll(&p, 1, timeout_ms) <= 0) { return 0; }
+
+    const ssize_t r = ::read(m_fd, buf, sz);
+    return (r > 0) ? r : 0;
+  }
+
+
+  /**
+   * @brief Start the worker thread
+   * @details The depth should not be raised above what fits in the firmware
+   *          receive buffer (SERIAL_RXBUF_SZ, 78 bytes), six queries at most.
+   *
+   */
+  client::client(transport& link, bool high_resolution, size_t depth, int timeout_ms)
+    : m_link(link), m_high_resolution(high_resolution), m_depth(depth ? depth : 1),
+      m_timeout(timeout_ms), m_resync(false), m_running(true)
+  {
+    m_worker = std::thread(&client::run, this);
+  }
+
+  client::~client()
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_running = false;
+    }
+    m_worker.join();
+  }
+
+
+  /**
+   * @brief Worker loop, writes the queue and dispatches the replies
+   *
+   */
+  void client::run()
+  {
+    char buf[64];
+
+    for(;;) {
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if(! m_running) { break; }
+      }
+
+      pump();
+
+      const size_t n = m_link.read(buf, sizeof(buf), 10);
+
+      if(m_resync) {
+        const auto now = std::chrono::steady_clock::now();
+        if(n) { m_last_rx = now; }
+        else if(now - m_last_rx >= m_timeout) { m_resync = false; }
+        continue;
+      }
+
+      m_rx.append(buf, n);
+
+      size_t end;
+      while((end = m_rx.find('#')) != std::string::npos) {
+        std::string reply = m_rx.substr(0, end);
+        m_rx.erase(0, end + 1);
+
+        // Drop the boot banner, it is not terminated by '#'
+        const size_t nl = reply.rfind('\n');
+        if(nl != std::string::npos) { reply.erase(0, nl + 1); }
+
+        request_t req;
+        {
+          std::lock_guard<std::mutex> lock(m_mutex);
+          if(m_inflight.empty()) { continue; }
+          req = std::move(m_inflight.front());
+          m_inflight.pop_front();
+        }
+
+        for(auto& w: req.waiters)   { w->set_value(reply); }
+        for(auto& cb: req.callbacks) { cb(reply); }
+      }
+
+      expire();
+    }
+
+    // Nobody is going to answer anymore
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for(auto* q: { &m_inflight, &m_pending }) {
+      for(auto& req: *q) {
+        for(auto& w: req.waiters) {
+          w->set_exception(std::make_exception_ptr(timeout_error(req.cmd)));
+        }
+      }
+      q->clear();
+    }
+  }
+
+
+  /**
+   * @brief Write queued frames while there are free pipeline slots
+   * @details Frames are written in submission order, a command queued after
+   *          a query waits for that query to get a slot.
+   *
+   */
+  void client::pump()
+  {
+    if(m_resync) { return; }
+
+    std::string out;
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      while(! m_pending.empty()) {
+        request_t& req = m_pending.front();
+        if(req.query && m_inflight.size() >= m_depth) { break; }
+
+        out += ":" + req.cmd + "#";
+        if(req.query) {
+          req.sent = std::chrono::steady_clock::now();
+          m_inflight.push_back(std::move(req));
+        }
+        m_pending.pop_front();
+      }
+    }
+
+    if(! out.empty()) { m_link.write(out); }
+  }
+
+
+  /**
+   * @brief Fail every query in flight when the oldest reply is overdue
+   * @details Replies come in order, a late head means its reply was lost or
+   *          is still on its way. Either way the replies in flight can no
+   *          longer be matched thus all of them fail and the link resyncs,
+   *          see run().
+   *
+   */
+  void client::expire()
+  {
+    std::deque<request_t> failed;
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if(m_inflight.empty()) { return; }
+      if(std::chrono::steady_clock::now() - m_inflight.front().sent < m_timeout) { return; }
+      failed.swap(m_inflight);
+    }
+
+    m_rx.clear();
+    m_resync = true;
+    m_last_rx = std::chrono::steady_clock::now();
+
+    for(auto& req: failed) {
+      for(auto& w: req.waiters) {
+        w->set_exception(std::make_exception_ptr(timeout_error(req.cmd)));
+      }
+    }
+  }
+
+
+  /**
+   * @brief Queue a frame, coalescing identical queries
+   * @details A query only joins an identical one that is not yet written and
+   *          has no command queued after it, otherwise the caller could get
+   *          a reply from before its own earlier command took effect. A query
+   *          already in flight may have been answered before that command.
+   *
+   */
+  client::request_t* client::enqueue(const std::string& cmd, const bool& query)
+  {
+    if(query) {
+      for(auto it = m_pending.rbegin(); it != m_pending.rend(); ++it) {
+        if(! it->query) { break; }
+        if(it->cmd == cmd) { return &(*it); }
+      }
+    }
+
+    request_t req;
+    req.cmd   = cmd;
+    req.query = query;
+    m_pending.push_back(std::move(req));
+    return &m_pending.back();
+  }
+
+  std::shared_future<std::string> client::query(const std::string& cmd)
+  {
+    auto p = std::make_shared<std::promise<std::string> >();
+    std::shared_future<std::string> f = p->get_future().share();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    enqueue(cmd, true)->waiters.push_back(p);
+    return f;
+  }
+
+  void client::query(const std::string& cmd, callback_t cb)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    enqueue(cmd, true)->callbacks.push_back(cb);
+  }
+
+  void client::command(const std::string& cmd)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    enqueue(cmd, false);
+  }
+
+  size_t client::outstanding()
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_pending.size() + m_inflight.size();
+  }
+
+
+  std::string client::frame(const motor_t& motor, const std::string& cmd) const
+  {
+    return (motor == MOTOR_TWO) ? "2" + cmd : cmd;
+  }
+
+  std::string client::hex(const uint32_t& value) const
+  {
+    char buf[9];
+    snprintf(buf, sizeof(buf), m_high_resolution ? "%08X" : "%04X",
+      m_high_resolution ? value : (value & 0xFFFF));
+    return buf;
+  }
+
+  std::future<uint32_t> client::get_position(const motor_t& motor)
+  {
+    std::shared_future<std::string> f = query(frame(motor, "GP"));
+    return std::async(std::launch::deferred, [f]() {
+      return (uint32_t) strtoul(f.get().c_str(), NULL, 16);
+    });
+  }
+
+  std::future<uint32_t> client::get_target(const motor_t& motor)
+  {
+    std::shared_future<std::string> f = query(frame(motor, "GN"));
+    return std::async(std::launch::deferred, [f]() {
+      return (uint32_t) strtoul(f.get().c_str(), NULL, 16);
+    });
+  }
+
+  std::future<bool> client::is_moving(const motor_t& motor)
+  {
+    std::shared_future<std::string> f = query(frame(motor, "GI"));
+    return std::async(std::launch::deferred, [f]() {
+      return strtoul(f.get().c_str(), NULL, 16) != 0;
+    });
+  }
+
+  std::future<uint8_t> client::get_speed(const motor_t& motor)
+  {
+    std::shared_future<std::string> f = query(frame(motor, "GD"));
+    return std::async(std::launch::deferred, [f]() {
+      return (uint8_t) strtoul(f.get().c_str(), NULL, 16);
+    });
+  }
+
+  /**
+   * @brief Read the temperature in Celsius
+   * @details The standard reply is a signed count of half degrees, in high
+   *          resolution mode the firmware sends the raw bits of the float.
+   *
+   */
+  std::future<float> client::get_temperature()
+  {
+    std::shared_future<std::string> f = query("GT");
+    const bool hires = m_high_resolution;
+
+    return std::async(std::launch::deferred, [f, hires]() {
+      const uint32_t raw = strtoul(f.get().c_str(), NULL, 16);
+      if(hires) {
+        float t;
+        memcpy(&t, &raw, sizeof(t));
+        return t;
+      }
+      return (int16_t) raw / 2.0f;
+    });
+  }
+
+  std::future<sample_t> client::get_sample(const motor_t& motor)
+  {
+    std::shared_future<std::string> f = query(frame(motor, "GS"));
+    const size_t digits = m_high_resolution ? 8 : 4;
+
+    return std::async(std::launch::deferred, [f, digits]() {
+      const std::string r = f.get();
+      sample_t s;
+      s.timestamp = strtoul(r.substr(0, 8).c_str(), NULL, 16);
+      s.position  = strtoul(r.substr(8, digits).c_str(), NULL, 16);
+      s.moving    = strtoul(r.substr(8 + digits).c_str(), NULL, 16) != 0;
+      return s;
+    });
+  }
+
+  void client::set_position(const motor_t& motor, const uint32_t& value)
+  {
+    command(frame(motor, "SP" + hex(value)));
+  }
+
+  void client::set_target(const motor_t& motor, const uint32_t& value)
+  {
+    command(frame(motor, "SN" + hex(value)));
+  }
+
+  void client::set_speed(const motor_t& motor, const uint8_t& value)
+  {
+    char buf[3];
+    snprintf(buf, sizeof(buf), "%02X", value);
+    command(frame(motor, std::string("SD") + buf));
+  }
+
+  /**
+   * @brief Align the device clock to a host clock, in uS
+   * @details The link delay is not accounted for, the caller can halve the
+   *          round trip of a get_sample() issued right after.
+   */
+  void client::set_clock(const uint32_t& us)
+  {
+    char buf[9];
+    snprintf(buf, sizeof(buf), "%08X", us);
+    command(std::string("SS") + buf);
+  }
+
+  void client::set_full_step(const motor_t& motor) { command(frame(motor, "SF")); }
+  void client::set_half_step(const motor_t& motor) { command(frame(motor, "SH")); }
+  void client::start(const motor_t& motor)         { command(frame(motor, "FG")); }
+  void client::stop(const motor_t& motor)          { command(frame(motor, "FQ")); }
+
+  void client::move(const motor_t& motor, const uint32_t& target)
+  {
+    command(frame(motor, "FN" + hex(target)));
+  }
+
+  /**
+   * @brief Move by a signed number of steps from the current target
+   * @details Applied by the firmware in one go, there is no need to read the
+   *          position first and nothing races with a move in progress.
+   */
+  void client::move_by(const motor_t& motor, const int32_t& delta)
+  {
+    command(frame(motor, "FR" + hex((uint32_t) delta)));
+  }
+}
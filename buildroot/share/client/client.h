@@ -0,0 +1,168 @@
+/**
+ * Ardufocus - Moonlite compatible focuser
+ * Copyright (C) 2017-2019 João Brázio [joao@brazio.org]
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __ARDUFOCUS_CLIENT_H__
+#define __ARDUFOCUS_CLIENT_H__
+
+#include <stdint.h>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Host side client for the Ardufocus protocol (see ardufocus/moonlite.h).
+ *
+ * Queries are pipelined on a single link: up to `depth` of them are kept in
+ * flight and replies are matched in order, the firmware answers every query
+ * with exactly one frame. A query issued while an identical one is still
+ * queued, with no command after it, is coalesced into it, so many pollers
+ * asking for the position cost a single exchange. Commands without a reply
+ * (moves, settings) are sent in order with the queries but never occupy a
+ * pipeline slot.
+ *
+ * A missing reply fails every query in flight, the link is then left alone
+ * until it has been quiet for a timeout period before the queue resumes.
+ *
+ * Build with: g++ -std=c++11 -pthread client.cpp your_app.cpp
+ * Run the tests with: make -C test
+ */
+namespace ardufocus {
+
+  enum motor_t { MOTOR_ONE, MOTOR_TWO };
+
+  // Device clock in uS (wraps every ~71 minutes), position and moving flag
+  // all captured at the same instant
+  struct sample_t {
+    uint32_t timestamp;
+    uint32_t position;
+    bool     moving;
+  };
+
+  class timeout_error: public std::runtime_error {
+    public:
+      timeout_error(const std::string& cmd): std::runtime_error("no reply to " + cmd) { ; }
+  };
+
+  /**
+   * @brief   Byte stream the client talks over
+   * @details read() must return after at most the given number of
+   *          milliseconds, returning zero when nothing arrived.
+   */
+  class transport {
+    public:
+      virtual ~transport() { ; }
+      virtual void   write(const std::string&) = 0;
+      virtual size_t read(char*, size_t, int) = 0;
+  };
+
+  /**
+   * @brief POSIX serial port transport, 8N1 raw mode
+   */
+  class serial_transport: public transport {
+    private:
+      int m_fd;
+
+    public:
+      serial_transport(const std::string& device, uint32_t baudrate = 9600);
+      ~serial_transport();
+
+      void   write(const std::string&);
+      size_t read(char*, size_t, int);
+  };
+
+  class client {
+    public:
+      typedef std::function<void(const std::string&)> callback_t;
+
+    private:
+      struct request_t {
+        std::string cmd;
+        bool query;
+        std::chrono::steady_clock::time_point sent;
+        std::vector<std::shared_ptr<std::promise<std::string> > > waiters;
+        std::vector<callback_t> callbacks;
+      };
+
+      transport& m_link;
+      const bool m_high_resolution;
+      const size_t m_depth;
+      const std::chrono::milliseconds m_timeout;
+
+      std::mutex m_mutex;
+      std::deque<request_t> m_pending;   // Not yet written
+      std::deque<request_t> m_inflight;  // Written, waiting for the reply
+      std::string m_rx;
+
+      // After a timeout nothing is written and every byte is dropped until
+      // the line has been quiet for a timeout period, a late reply would
+      // otherwise be matched to the next query
+      bool m_resync;
+      std::chrono::steady_clock::time_point m_last_rx;
+
+      bool m_running;
+      std::thread m_worker;
+
+      void run();
+      void pump();
+      void expire();
+      request_t* enqueue(const std::string&, const bool&);
+      std::string frame(const motor_t&, const std::string&) const;
+      std::string hex(const uint32_t&) const;
+
+    public:
+      client(transport& link, bool high_resolution = false, size_t depth = 4,
+        int timeout_ms = 1000);
+      ~client();
+
+      // Raw access, cmd is the frame body without ':' and '#'. Callbacks run
+      // on the worker thread and are dropped when the query times out.
+      std::shared_future<std::string> query(const std::string& cmd);
+      void query(const std::string& cmd, callback_t cb);
+      void command(const std::string& cmd);
+
+      std::future<uint32_t> get_position(const motor_t& = MOTOR_ONE);
+      std::future<uint32_t> get_target(const motor_t& = MOTOR_ONE);
+      std::future<bool>     is_moving(const motor_t& = MOTOR_ONE);
+      std::future<uint8_t>  get_speed(const motor_t& = MOTOR_ONE);
+      std::future<float>    get_temperature();
+      std::future<sample_t> get_sample(const motor_t& = MOTOR_ONE);
+
+      void set_position(const motor_t&, const uint32_t&);
+      void set_target(const motor_t&, const uint32_t&);
+      void set_speed(const motor_t&, const uint8_t&);
+      void set_full_step(const motor_t& = MOTOR_ONE);
+      void set_half_step(const motor_t& = MOTOR_ONE);
+      void set_clock(const uint32_t&);
+      void move(const motor_t&, const uint32_t&);
+      void move_by(const motor_t&, const int32_t&);
+      void start(const motor_t& = MOTOR_ONE);
+      void stop(const motor_t& = MOTOR_ONE);
+
+      size_t outstanding();
+  };
+}
+
+#endif
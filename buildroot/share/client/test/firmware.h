@@ -0,0 +1,195 @@
+/**
+ * Ardufocus - Moonlite compatible focuser
+ * Copyright (C) 2017-2019 João Brázio [joao@brazio.org]
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __FIRMWARE_H__
+#define __FIRMWARE_H__
+
+/**
+ * Host build of the firmware command parser (ardufocus/moonlite.h).
+ *
+ * The config, api, serial and profile headers are replaced by the stand-ins
+ * below, their include guards are taken first thus moonlite.h picks these up
+ * instead. The motors are plain variables, a move lands on its target at
+ * once. Define HIGH_RESOLUTION_MODE to build the 32-bit protocol.
+ */
+
+#define __CONFIG_H__
+#define __API_H__
+#define __SERIAL_H__
+#define __PROFILE_H__
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <deque>
+#include <string>
+
+#define PROGMEM
+#define PSTR(s) (s)
+#define pgm_read_byte(p) (*(const char*)(p))
+#define sprintf_P sprintf
+#define strcpy_P  strcpy
+
+namespace util
+{
+  inline uint16_t  hex2l(const char* str) { return ( strtol(str, NULL, 16)); }
+  inline uint32_t hex2ul(const char* str) { return (strtoul(str, NULL, 16)); }
+};
+
+enum motor_t {
+  MOTOR_ONE,
+  MOTOR_TWO
+};
+
+struct sample_t {
+  uint32_t timestamp;
+  uint32_t position;
+  bool     moving;
+};
+
+namespace device
+{
+  struct motor_state_t {
+    uint32_t position, target;
+    uint8_t  speed, mode;
+    bool     moving;
+  };
+
+  static motor_state_t motor[2];
+  static uint32_t clock_us = 0;
+  static float temperature = 21.0F;
+
+  // Serial line, as seen from the firmware
+  static std::deque<char> rx;
+  static std::string tx;
+};
+
+class api {
+  public:
+    static void update_temperature() { ; }
+    static float get_temperature(const uint8_t&) { return device::temperature; }
+
+    static bool motor_home(const motor_t&) { return false; }
+
+    static void motor_start(const motor_t& idx) {
+      device::motor[idx].position = device::motor[idx].target;
+    }
+
+    static void motor_move_by(const motor_t& idx, const int32_t& delta) {
+      device::motor[idx].target += delta;
+    }
+
+    static void motor_stop(const motor_t& idx) {
+      device::motor[idx].target = device::motor[idx].position;
+      device::motor[idx].moving = false;
+    }
+
+    static uint8_t  motor_get_speed(const motor_t& idx)    { return device::motor[idx].speed;    }
+    static uint8_t  motor_get_mode(const motor_t& idx)     { return device::motor[idx].mode;     }
+    static uint8_t  motor_is_moving(const motor_t& idx)    { return device::motor[idx].moving;   }
+    static uint32_t motor_get_target(const motor_t& idx)   { return device::motor[idx].target;   }
+    static uint32_t motor_get_position(const motor_t& idx) { return device::motor[idx].position; }
+
+    static sample_t motor_get_sample(const motor_t& idx) {
+      sample_t s = { device::clock_us, device::motor[idx].position, device::motor[idx].moving };
+      return s;
+    }
+
+    static void set_clock(const uint32_t& us) { device::clock_us = us; }
+
+    static void motor_set_speed(const motor_t& idx, const uint32_t& value) {
+      device::motor[idx].speed = value;
+    }
+
+    static void motor_set_mode_full(const motor_t& idx)    { device::motor[idx].mode = 0x00; }
+    static void motor_set_mode_half(const motor_t& idx)    { device::motor[idx].mode = 0xFF; }
+    static void motor_set_mode_quarter(const motor_t& idx) { device::motor[idx].mode = 0xFF; }
+
+    static void motor_set_target(const motor_t& idx, const uint32_t& value) {
+      device::motor[idx].target = value;
+    }
+
+    static void motor_set_position(const motor_t& idx, const uint32_t& value) {
+      device::motor[idx].position = value;
+      device::motor[idx].target   = value;
+    }
+
+    static uint16_t get_eeprom_saves() { return 0; }
+};
+
+// Same framing as ardufocus/serial.h, over the device::rx and device::tx. The
+// protocol macros are defined later by moonlite.h thus the characters are spelled
+// out and the buffer has the longest frame size.
+template<uint8_t N> class serial {
+  protected:
+    void setup() { ; }
+    bool writable() { return true; }
+
+    size_t write(const char& c) {
+      device::tx += c;
+      return 1;
+    }
+
+    size_t write(const char* str) {
+      size_t n = 0;
+      while (*str) { write(*str++); ++n; }
+      return n;
+    }
+
+    size_t write_P(const char* str) { return write(str); }
+
+    size_t receive(char* const str) {
+      static size_t pos = 0;
+      static char buff[16];
+
+      while(! device::rx.empty()) {
+        const char c = device::rx.front();
+        device::rx.pop_front();
+
+        switch(c) {
+          case '#': {
+            strcpy(str, buff);
+            size_t sz = pos;
+            memset(&buff, 0, sizeof(buff));
+            pos = 0;
+            return sz;
+          }
+
+          case ':':
+            memset(&buff, 0, sizeof(buff));
+            pos = 0;
+            break;
+
+          case '\r':
+            break;
+
+          default:
+            buff[pos++] = c;
+            pos %= sizeof(buff);
+            break;
+        }
+      }
+      return 0;
+    }
+};
+
+#include "moonlite.h"
+
+#endif
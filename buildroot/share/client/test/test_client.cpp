@@ -0,0 +1,359 @@
+/**
+ * Ardufocus - Moonlite compatible focuser
+ * Copyright (C) 2017-2019 João Brázio [joao@brazio.org]
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * Client tests against the real firmware command parser, build and run with
+ * "make" from this directory. Both protocol widths are covered, the binary
+ * built with HIGH_RESOLUTION_MODE talks the 32-bit one.
+ */
+
+#include "firmware.h"
+#include "client.h"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+#ifdef HIGH_RESOLUTION_MODE
+  static const bool s_hires = true;
+#else
+  static const bool s_hires = false;
+#endif
+
+static int s_failures = 0;
+
+#define CHECK(expr) do { \
+    if(! (expr)) { \
+      fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #expr); \
+      ++s_failures; \
+    } \
+  } while(0)
+
+/**
+ * @brief   Transport wired straight into the firmware parser
+ * @details Every read() runs one pass of the firmware main loop unless the
+ *          device is held, a held device leaves the frames on the wire. A
+ *          deaf device drops everything written to it.
+ */
+class loopback: public ardufocus::transport {
+  private:
+    std::mutex m_mutex;
+    std::string m_wire;
+    size_t m_frames = 0;
+
+  public:
+    std::atomic<bool> hold;
+    std::atomic<bool> deaf;
+
+    loopback(): hold(false), deaf(false) { ; }
+
+    void write(const std::string& data) {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      for(const char c: data) { if(c == CMD_START_CHAR) { ++m_frames; } }
+      if(! deaf) { m_wire += data; }
+    }
+
+    size_t read(char* buf, size_t sz, int) {
+      size_t n;
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if(! hold) {
+          device::rx.insert(device::rx.end(), m_wire.begin(), m_wire.end());
+          m_wire.clear();
+          comms.banner();
+          comms.receive();
+        }
+
+        n = std::min(sz, device::tx.size());
+        memcpy(buf, device::tx.data(), n);
+        device::tx.erase(0, n);
+      }
+
+      if(! n) { std::this_thread::sleep_for(std::chrono::milliseconds(1)); }
+      return n;
+    }
+
+    // Frames written by the client so far
+    size_t frames() {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      return m_frames;
+    }
+
+    // Wait for the client to write a number of frames
+    bool wait_frames(const size_t& n) {
+      for(int i = 0; i < 1000; i++) {
+        if(frames() >= n) { return true; }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+      return false;
+    }
+};
+
+static void reset_device()
+{
+  memset(device::motor, 0, sizeof(device::motor));
+  device::clock_us = 0;
+  device::temperature = 21.0F;
+}
+
+/**
+ * @brief First reply after the boot banner, commands and the second channel
+ *
+ */
+static void test_commands()
+{
+  reset_device();
+  loopback link;
+  ardufocus::client c(link, s_hires);
+
+  c.set_position(ardufocus::MOTOR_ONE, 0x1234);
+  CHECK(c.get_position().get() == 0x1234);
+
+  c.set_position(ardufocus::MOTOR_TWO, 0x0ABC);
+  c.set_speed(ardufocus::MOTOR_TWO, 0x08);
+  c.set_half_step(ardufocus::MOTOR_TWO);
+  CHECK(c.get_position(ardufocus::MOTOR_TWO).get() == 0x0ABC);
+  CHECK(c.get_speed(ardufocus::MOTOR_TWO).get() == 0x08);
+  CHECK(device::motor[MOTOR_ONE].position == 0x1234);
+  CHECK(device::motor[MOTOR_ONE].speed == 0);
+  CHECK(device::motor[MOTOR_ONE].mode == 0x00);
+  CHECK(device::motor[MOTOR_TWO].mode == 0xFF);
+
+  c.move(ardufocus::MOTOR_TWO, 0x0100);
+  CHECK(c.get_position(ardufocus::MOTOR_TWO).get() == 0x0100);
+
+  c.set_target(ardufocus::MOTOR_ONE, 0x2000);
+  CHECK(c.get_target().get() == 0x2000);
+  CHECK(c.get_position().get() == 0x1234);
+  c.start();
+  CHECK(c.get_position().get() == 0x2000);
+}
+
+/**
+ * @brief Field widths of the standard and the high resolution protocol
+ *
+ */
+static void test_widths()
+{
+  reset_device();
+  loopback link;
+  ardufocus::client c(link, s_hires);
+
+  // Values above 16 bits only survive in high resolution mode
+  c.set_position(ardufocus::MOTOR_TWO, 0x12345678);
+  CHECK(c.get_position(ardufocus::MOTOR_TWO).get() == (s_hires ? 0x12345678 : 0x5678));
+
+  // A negative relative move is sent in two's complement of the field width
+  c.set_position(ardufocus::MOTOR_ONE, 0x0100);
+  c.move_by(ardufocus::MOTOR_ONE, -16);
+  CHECK(c.get_target().get() == 0x00F0);
+  CHECK(c.get_position().get() == 0x0100);
+
+  c.set_clock(0xDEADBEEF);
+  c.set_position(ardufocus::MOTOR_TWO, 0x00ABCDEF);
+  const ardufocus::sample_t s = c.get_sample(ardufocus::MOTOR_TWO).get();
+  CHECK(s.timestamp == 0xDEADBEEF);
+  CHECK(s.position == (s_hires ? 0x00ABCDEF : 0xCDEF));
+  CHECK(! s.moving);
+
+  // The high resolution reply is the raw float, which only an 8-bit host
+  // printf produces, thus only the standard encoding is checked here
+  if(! s_hires) {
+    device::temperature = -5.0F;
+    CHECK(c.get_temperature().get() == -5.0F);
+  }
+}
+
+/**
+ * @brief No more than depth queries are on the wire at any time
+ *
+ */
+static void test_pipelining()
+{
+  reset_device();
+  device::motor[MOTOR_ONE].position = 0x0011;
+  device::motor[MOTOR_ONE].target   = 0x0022;
+  device::motor[MOTOR_ONE].speed    = 0x02;
+  device::motor[MOTOR_TWO].position = 0x0033;
+  device::motor[MOTOR_TWO].target   = 0x0044;
+  device::motor[MOTOR_TWO].speed    = 0x04;
+
+  loopback link;
+  link.hold = true;
+  ardufocus::client c(link, s_hires, 4);
+
+  auto p1 = c.get_position(ardufocus::MOTOR_ONE);
+  auto t1 = c.get_target(ardufocus::MOTOR_ONE);
+  auto d1 = c.get_speed(ardufocus::MOTOR_ONE);
+  auto p2 = c.get_position(ardufocus::MOTOR_TWO);
+  auto t2 = c.get_target(ardufocus::MOTOR_TWO);
+  auto d2 = c.get_speed(ardufocus::MOTOR_TWO);
+
+  CHECK(link.wait_frames(4));
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  CHECK(link.frames() == 4);
+  CHECK(c.outstanding() == 6);
+
+  link.hold = false;
+  CHECK(p1.get() == 0x0011);
+  CHECK(t1.get() == 0x0022);
+  CHECK(d1.get() == 0x02);
+  CHECK(p2.get() == 0x0033);
+  CHECK(t2.get() == 0x0044);
+  CHECK(d2.get() == 0x04);
+  CHECK(link.frames() == 6);
+  CHECK(c.outstanding() == 0);
+}
+
+/**
+ * @brief Identical queries only merge while queued and not behind a command
+ *
+ */
+static void test_merging()
+{
+  reset_device();
+  device::motor[MOTOR_ONE].position = 0x0010;
+
+  {
+    loopback link;
+    link.hold = true;
+    ardufocus::client c(link, s_hires, 1);
+
+    // Occupy the only pipeline slot
+    auto busy = c.get_speed();
+    CHECK(link.wait_frames(1));
+
+    auto a = c.get_position();
+    auto b = c.get_position();
+    c.set_position(ardufocus::MOTOR_ONE, 0x0042);
+    auto d = c.get_position();
+    auto e = c.get_position();
+
+    // busy, the merged a/b, the command, the merged d/e
+    CHECK(c.outstanding() == 4);
+
+    link.hold = false;
+    CHECK(busy.get() == 0x00);
+    CHECK(a.get() == 0x0010);
+    CHECK(b.get() == 0x0010);
+    CHECK(d.get() == 0x0042);
+    CHECK(e.get() == 0x0042);
+    CHECK(link.frames() == 4);
+  }
+
+  {
+    loopback link;
+    link.hold = true;
+    ardufocus::client c(link, s_hires, 4);
+
+    // Already written, the device may have answered it
+    auto a = c.get_position();
+    CHECK(link.wait_frames(1));
+
+    auto b = c.get_position();
+    CHECK(link.wait_frames(2));
+    CHECK(c.outstanding() == 2);
+
+    link.hold = false;
+    CHECK(a.get() == 0x0042);
+    CHECK(b.get() == 0x0042);
+  }
+}
+
+/**
+ * @brief A lost reply fails its query and the link recovers afterwards
+ *
+ */
+static void test_timeout()
+{
+  reset_device();
+  device::motor[MOTOR_ONE].position = 0x0077;
+
+  loopback link;
+  link.deaf = true;
+  ardufocus::client c(link, s_hires, 4, 100);
+
+  const auto start = std::chrono::steady_clock::now();
+  auto f = c.get_position();
+
+  bool timed_out = false;
+  try { f.get(); }
+  catch(const ardufocus::timeout_error&) { timed_out = true; }
+
+  CHECK(timed_out);
+  CHECK(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(100));
+  CHECK(c.outstanding() == 0);
+
+  link.deaf = false;
+  CHECK(c.get_position().get() == 0x0077);
+}
+
+/**
+ * @brief A reply that arrives after its timeout is never handed to the next query
+ *
+ */
+static void test_late_reply()
+{
+  reset_device();
+  device::motor[MOTOR_ONE].position = 0x0077;
+  device::motor[MOTOR_ONE].target   = 0x0088;
+  device::motor[MOTOR_ONE].speed    = 0x10;
+
+  loopback link;
+  link.hold = true;
+  ardufocus::client c(link, s_hires, 4, 100);
+
+  auto a = c.get_position();
+  auto b = c.get_target();
+  CHECK(link.wait_frames(2));
+
+  // Both in flight queries fail with the head
+  bool timed_out = false;
+  try { a.get(); }
+  catch(const ardufocus::timeout_error&) { timed_out = true; }
+  CHECK(timed_out);
+
+  timed_out = false;
+  try { b.get(); }
+  catch(const ardufocus::timeout_error&) { timed_out = true; }
+  CHECK(timed_out);
+
+  // Queued while the link resyncs, the stale replies come out first
+  auto d = c.get_speed();
+  link.hold = false;
+
+  CHECK(d.get() == 0x10);
+  CHECK(link.frames() == 3);
+  CHECK(c.get_position().get() == 0x0077);
+}
+
+int main()
+{
+  test_commands();
+  test_widths();
+  test_pipelining();
+  test_merging();
+  test_timeout();
+  test_late_reply();
+
+  printf("%s protocol: %s\n", s_hires ? "high resolution" : "standard",
+    s_failures ? "FAILED" : "passed");
+  return s_failures ? 1 : 0;
+}
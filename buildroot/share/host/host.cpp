@@ -0,0 +1,91 @@
+/**
+ * Ardufocus - Moonlite compatible focuser
+ * Copyright (C) 2017-2019 João Brázio [joao@brazio.org]
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <avr/io.h>
+#include <avr/eeprom.h>
+#include <avr/sleep.h>
+#include <avr/wdt.h>
+#include <util/delay.h>
+
+#define HOST_DEFINE_REGISTER_8(n)  volatile uint8_t  n = 0;
+#define HOST_DEFINE_REGISTER_16(n) volatile uint16_t n = 0;
+HOST_REGISTERS_8(HOST_DEFINE_REGISTER_8)
+HOST_REGISTERS_16(HOST_DEFINE_REGISTER_16)
+
+namespace host
+{
+  volatile uint8_t pin_dir[256];
+  volatile uint8_t pin_level[256];
+
+  uint8_t eeprom[1024];
+  std::function<void(const uint16_t&, const uint8_t*, const size_t&)> on_eeprom_write;
+
+  std::function<void(const double&)> on_delay_us;
+
+  std::function<void()> on_loop;
+
+  std::deque<char> serial_rx[2];
+  std::string serial_tx[2];
+
+  uintptr_t pin_lookup(const uint8_t& pin, const uint8_t& reg)
+  {
+    switch(reg) {
+      case IO_DIR:  return (uintptr_t) &pin_dir[pin];
+      case IO_DATA:
+      case IO_IN:   return (uintptr_t) &pin_level[pin];
+      default:      return 0x01;
+    }
+  }
+
+  void delay_cycles(const uint32_t& n)
+  {
+    if(on_delay_us) { on_delay_us(n / (F_CPU / 1000000.0)); }
+  }
+};
+
+void _delay_us(double us) { if(host::on_delay_us) { host::on_delay_us(us); } }
+void _delay_ms(double ms) { if(host::on_delay_us) { host::on_delay_us(ms * 1000.0); } }
+
+// A fresh EEPROM reads as 0xFF
+static struct eeprom_erase_t {
+  eeprom_erase_t() { memset(host::eeprom, 0xFF, sizeof(host::eeprom)); }
+} s_eeprom_erase;
+
+void eeprom_busy_wait() { ; }
+uint8_t eeprom_is_ready() { return 1; }
+
+void eeprom_read_block(void* dst, const void* src, size_t n)
+{
+  memcpy(dst, host::eeprom + (uintptr_t) src, n);
+}
+
+void eeprom_update_block(const void* src, void* dst, size_t n)
+{
+  // The hook runs first thus it can tell the bytes that actually change
+  if(host::on_eeprom_write) { host::on_eeprom_write((uintptr_t) dst, (const uint8_t*) src, n); }
+  memcpy(host::eeprom + (uintptr_t) dst, src, n);
+}
+
+// Register the bootloader hands MCUSR over on, see warmboot_early()
+extern "C" { uint8_t r2 = 0; }
+
+void wdt_disable()   { ; }
+void wdt_enable(int) { ; }
+void wdt_reset()     { ; }
+void sleep_mode()    { ; }
@@ -0,0 +1,76 @@
+/**
+ * Ardufocus - Moonlite compatible focuser
+ * Copyright (C) 2017-2019 João Brázio [joao@brazio.org]
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __HOST_AVR_IO_H__
+#define __HOST_AVR_IO_H__
+
+/**
+ * Host stand-in for the ATmega328P register file, every register is a plain
+ * variable (see host.cpp) thus the firmware can be compiled and run on a PC.
+ */
+
+#include <stdint.h>
+
+#define HOST_REGISTERS_8(X) \
+  X(DDRB) X(DDRC) X(DDRD) X(PORTB) X(PORTC) X(PORTD) X(PINB) X(PINC) X(PIND) \
+  X(TCCR0A) X(TCCR0B) X(TIMSK0) X(TIFR0) X(TCNT0) X(OCR0A) X(OCR0B) \
+  X(TCCR1A) X(TCCR1B) X(TCCR1C) X(TIMSK1) X(TIFR1) \
+  X(TCCR2A) X(TCCR2B) X(TIMSK2) X(TIFR2) X(TCNT2) X(OCR2A) X(OCR2B) \
+  X(UBRR0H) X(UBRR0L) X(UCSR0A) X(UCSR0B) X(UCSR0C) X(UDR0) \
+  X(UBRR1H) X(UBRR1L) X(UCSR1A) X(UCSR1B) X(UCSR1C) X(UDR1) \
+  X(ADCSRA) X(ADMUX) X(DIDR0) X(SREG) X(MCUSR) \
+  X(PCICR) X(PCMSK0) X(PCMSK1) X(PCMSK2) X(PCIFR) \
+  X(SPCR) X(SPSR) X(SPDR) X(GPIOR0) X(GPIOR1) X(GPIOR2) X(SMCR) X(PRR)
+
+#define HOST_REGISTERS_16(X) \
+  X(TCNT1) X(OCR1A) X(OCR1B) X(ICR1) X(ADCW)
+
+#define HOST_DECLARE_REGISTER_8(n)  extern volatile uint8_t  n;
+#define HOST_DECLARE_REGISTER_16(n) extern volatile uint16_t n;
+HOST_REGISTERS_8(HOST_DECLARE_REGISTER_8)
+HOST_REGISTERS_16(HOST_DECLARE_REGISTER_16)
+
+#define ADC ADCW
+
+#define PB0 0
+#define PB1 1
+#define PB2 2
+#define PB3 3
+#define PB4 4
+#define PB5 5
+#define PC2 2
+#define PC3 3
+
+enum {
+  WGM01 = 1, CS00 = 0, CS01 = 1, CS02 = 2, OCIE0A = 1, OCF0A = 1,
+  WGM21 = 1, CS20 = 0, CS21 = 1, CS22 = 2, OCIE2A = 1, OCF2A = 1,
+  WGM12 = 3, CS10 = 0, CS11 = 1, CS12 = 2, OCIE1A = 1, TOIE1 = 0, OCF1A = 1, TOV1 = 0,
+  UDRE0 = 5, UDRIE0 = 5, UPE0 = 2, RXCIE0 = 7, RXEN0 = 4, TXC0 = 6, TXEN0 = 3, U2X0 = 1, TXCIE0 = 6,
+  UDRE1 = 5, UDRIE1 = 5, UPE1 = 2, RXCIE1 = 7, RXEN1 = 4, TXC1 = 6, TXEN1 = 3, U2X1 = 1, TXCIE1 = 6,
+  ADPS0 = 0, ADPS1 = 1, ADPS2 = 2, ADEN = 7, ADSC = 6, ADIE = 3, REFS0 = 6, REFS1 = 7,
+  ADC4D = 4, ADC5D = 5, SREG_I = 7,
+  PORF = 0, EXTRF = 1, BORF = 2, WDRF = 3, PCIE0 = 0, PCIE1 = 1, PCIE2 = 2,
+  SPE = 6, MSTR = 4, SPIF = 7, SPI2X = 0, SPR0 = 0, SE = 0, SM0 = 1, UCSZ00 = 1, UCSZ01 = 2
+};
+
+#define _BV(b) (1 << (b))
+#define bit_is_set(r, b)   ((r) & _BV(b))
+#define bit_is_clear(r, b) (!((r) & _BV(b)))
+
+#endif
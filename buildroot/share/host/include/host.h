@@ -0,0 +1,140 @@
+/**
+ * Ardufocus - Moonlite compatible focuser
+ * Copyright (C) 2017-2019 João Brázio [joao@brazio.org]
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __HOST_H__
+#define __HOST_H__
+
+/**
+ * Host build of the firmware, force included ahead of every translation unit.
+ *
+ * The pin table and the serial port are replaced by the versions below, their
+ * include guards are taken first thus the firmware headers pick these up. The
+ * rest of the firmware is compiled unchanged against the AVR stand-ins found
+ * next to this file. Nothing runs by itself, the host program calls the ISRs
+ * and the driver methods itself, or drives the firmware main loop through
+ * on_loop (see sim.cpp).
+ */
+
+// Included before macro.h redefines NULL
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <deque>
+#include <functional>
+#include <string>
+
+namespace host
+{
+  // One byte per pin, an output reads back its own level and a test drives
+  // an input by writing it
+  extern volatile uint8_t pin_dir[256];
+  extern volatile uint8_t pin_level[256];
+
+  // Simulated EEPROM, the hook sees every eeprom_update_block()
+  extern uint8_t eeprom[1024];
+  extern std::function<void(const uint16_t&, const uint8_t*, const size_t&)> on_eeprom_write;
+
+  // Every busy wait, in microseconds
+  extern std::function<void(const double&)> on_delay_us;
+
+  // Every main loop pass, comms.receive() is the first thing it calls
+  extern std::function<void()> on_loop;
+
+  // Serial buffers as seen from the firmware, one per USART
+  extern std::deque<char> serial_rx[2];
+  extern std::string serial_tx[2];
+
+  uintptr_t pin_lookup(const uint8_t&, const uint8_t&);
+  void delay_cycles(const uint32_t&);
+};
+
+// Pin table -----------------------------------------------------------------
+#define __HAL_H__
+
+enum hal_register_headers_t { IO_DIR, IO_DATA, IO_IN, IO_BIT };
+#define hal_tbl_lookup(a, b) host::pin_lookup(a, b)
+
+#define __builtin_avr_delay_cycles(n) host::delay_cycles(n)
+
+// Serial port ---------------------------------------------------------------
+// Same framing as ardufocus/serial.h, the protocol macros are only defined
+// later by moonlite.h thus the characters are spelled out here
+#define __SERIAL_H__
+
+template<uint8_t N> class serial {
+  protected:
+    void setup() { ; }
+
+    // Room left on a TX buffer of SERIAL_TXBUF_SZ bytes, the bytes stay on
+    // serial_tx until the program moves them out on the line
+    bool writable() { return host::serial_tx[N].size() < 39; }
+
+    size_t write(const char& c) {
+      host::serial_tx[N] += c;
+      return 1;
+    }
+
+    size_t write(const char* str) {
+      size_t n = 0;
+      while (*str) { write(*str++); ++n; }
+      return n;
+    }
+
+    size_t write_P(const char* str) { return write(str); }
+
+    size_t receive(char* const str) {
+      static size_t pos = 0;
+      static char buff[16];
+
+      if(N == 0 && host::on_loop) { host::on_loop(); }
+
+      while(! host::serial_rx[N].empty()) {
+        const char c = host::serial_rx[N].front();
+        host::serial_rx[N].pop_front();
+
+        switch(c) {
+          case '#': {
+            strcpy(str, buff);
+            size_t sz = pos;
+            memset(&buff, 0, sizeof(buff));
+            pos = 0;
+            return sz;
+          }
+
+          case ':':
+            memset(&buff, 0, sizeof(buff));
+            pos = 0;
+            break;
+
+          case '\r':
+            break;
+
+          default:
+            buff[pos++] = c;
+            pos %= sizeof(buff) - 1;
+            break;
+        }
+      }
+      return 0;
+    }
+};
+
+#endif
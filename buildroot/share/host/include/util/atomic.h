@@ -0,0 +1,30 @@
+/**
+ * Ardufocus - Moonlite compatible focuser
+ * Copyright (C) 2017-2019 João Brázio [joao@brazio.org]
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __HOST_UTIL_ATOMIC_H__
+#define __HOST_UTIL_ATOMIC_H__
+
+// The simulation is single threaded, an ISR never preempts the main loop
+#define ATOMIC_RESTORESTATE    0
+#define ATOMIC_FORCEON         0
+#define NONATOMIC_RESTORESTATE 0
+#define ATOMIC_BLOCK(type)    for(int __atomic_once = 1; __atomic_once; __atomic_once = 0)
+#define NONATOMIC_BLOCK(type) for(int __atomic_once = 1; __atomic_once; __atomic_once = 0)
+
+#endif
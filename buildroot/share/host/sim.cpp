@@ -0,0 +1,245 @@
+/**
+ * Ardufocus - Moonlite compatible focuser
+ * Copyright (C) 2017-2019 João Brázio [joao@brazio.org]
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * Virtual time simulator, runs the firmware against the host side of a
+ * session capture (see buildroot/bin/session). Build with "make sim", the
+ * capture is read from stdin and the simulated session written to stdout:
+ *
+ *   build/default/sim [--baud N] [--tail S] [--eeprom IMAGE] < a.cap > b.cap
+ *
+ * Every pass of the firmware main loop advances the clock by one Timer0 tick
+ * (200us), which runs the step ISR when the timer is enabled, the uptime ISR
+ * every millisecond and moves the serial line bytes at the baud rate. Besides
+ * the replies the output logs every step and every EEPROM write:
+ *
+ *   # step <tick> <motor> <+/-units>
+ *   # eeprom <tick> <address> <length> <changed bytes> <data>
+ *
+ * The run ends once the input is done, the tail elapsed and no motor moves.
+ */
+
+// Ahead of the firmware headers, macro.h redefines some of their names
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "isr.h"
+#include "eeprom.h"
+#include "stepper.h"
+
+extern "C" void TIMER0_COMPA_vect(void);
+extern "C" void TIMER2_COMPA_vect(void);
+int ardufocus_main(void);
+
+struct byte_t {
+  uint64_t at;  // Time the byte is fully on the line (uS)
+  char c;
+};
+
+struct frame_t {
+  uint64_t at;  // Time the first byte goes on the line (uS)
+  std::string data;
+};
+
+static struct {
+  uint32_t baud = 9600;
+  uint64_t tail = 1000000;
+  const char* eeprom = NULL;
+  uint16_t max_speed = 0, min_speed = 0;
+} s_opt;
+
+static uint64_t s_tick = 0;
+static std::deque<byte_t> s_rx;
+static std::deque<frame_t> s_rx_frames;
+static uint64_t s_rx_end = 0;  // Last input byte on the line
+static uint64_t s_tx_free = 0; // The TX line is busy until then
+static std::string s_tx_frame;
+
+static stepper** const s_motor[2] = {
+  #ifdef MOTOR1_HAS_DRIVER
+    &g_motor1,
+  #else
+    NULL,
+  #endif
+  #ifdef MOTOR2_HAS_DRIVER
+    &g_motor2,
+  #else
+    NULL,
+  #endif
+};
+
+static inline uint64_t now() { return s_tick * TIMER0_TICK; }
+static inline uint64_t byte_time() { return 10000000ULL / s_opt.baud; }
+
+static void load_capture(FILE* in)
+{
+  char line[256];
+  while(fgets(line, sizeof(line), in)) {
+    double ts;
+    char dir, frame[200];
+    if(line[0] == '#' || sscanf(line, "%lf %c %199s", &ts, &dir, frame) != 3 || dir != '>') { continue; }
+
+    // Back to back frames queue up on the line
+    uint64_t at = (uint64_t) (ts * 1e6);
+    if(at < s_rx_end) { at = s_rx_end; }
+    s_rx_frames.push_back({ at, frame });
+
+    for(const char* p = frame; *p; p++) {
+      at += byte_time();
+      s_rx.push_back({ at, *p });
+    }
+    s_rx_end = at;
+  }
+}
+
+static void eeprom_image(const char* mode)
+{
+  if(! s_opt.eeprom) { return; }
+  FILE* f = fopen(s_opt.eeprom, mode);
+  if(! f) { return; }
+  if(*mode == 'r') { fread(host::eeprom, 1, sizeof(host::eeprom), f); }
+  else { fwrite(host::eeprom, 1, sizeof(host::eeprom), f); }
+  fclose(f);
+}
+
+static void eeprom_write(const uint16_t& addr, const uint8_t* src, const size_t& n)
+{
+  size_t changed = 0;
+  for(size_t i = 0; i < n; i++) { changed += (host::eeprom[addr + i] != src[i]); }
+
+  printf("# eeprom %llu %u %u %u ", (unsigned long long) s_tick, addr, (unsigned) n, (unsigned) changed);
+  for(size_t i = 0; i < n; i++) { printf("%02X", src[i]); }
+  printf("\n");
+}
+
+// Moves the firmware output to the line one byte time apart, the boot banner
+// is not a frame
+static void drain_tx(const bool& all = false)
+{
+  std::string& tx = host::serial_tx[0];
+  while(! tx.empty() && (all || s_tx_free <= now())) {
+    s_tx_free = ((s_tx_free > now()) ? s_tx_free : now()) + byte_time();
+    s_tx_frame += tx[0];
+    tx.erase(0, 1);
+
+    if(s_tx_frame.back() == '#') {
+      const size_t nl = s_tx_frame.find_last_of('\n');
+      if(nl != std::string::npos) { s_tx_frame.erase(0, nl + 1); }
+      printf("%.6f < %s\n", s_tx_free / 1e6, s_tx_frame.c_str());
+      s_tx_frame.clear();
+    }
+  }
+}
+
+static bool idle()
+{
+  for(stepper** m: s_motor) {
+    if(m && (*m)->is_moving()) { return false; }
+  }
+  return true;
+}
+
+static void finish()
+{
+  drain_tx(true);
+  eeprom_image("wb");
+  fflush(stdout);
+  exit(0);
+}
+
+/**
+ * @brief Advance the clock by one Timer0 tick
+ * @details Called at the top of every main loop pass, i.e. from the first
+ * comms.receive() call after the boot sequence.
+ *
+ */
+static void loop()
+{
+  if(! s_tick) {
+    for(stepper** m: s_motor) {
+      if(! m) { continue; }
+      if(s_opt.max_speed) { (*m)->set_max_speed(s_opt.max_speed); }
+      if(s_opt.min_speed) { (*m)->set_min_speed(s_opt.min_speed); }
+    }
+  }
+
+  ++s_tick;
+  drain_tx();
+
+  while(! s_rx_frames.empty() && s_rx_frames.front().at <= now()) {
+    printf("%.6f > %s\n", s_rx_frames.front().at / 1e6, s_rx_frames.front().data.c_str());
+    s_rx_frames.pop_front();
+  }
+
+  while(! s_rx.empty() && s_rx.front().at <= now()) {
+    host::serial_rx[0].push_back(s_rx.front().c);
+    s_rx.pop_front();
+  }
+
+  if((TCCR0B & TIMER0_CS) && (TIMSK0 & bit(OCIE0A))) {
+    uint32_t pos[2] = { 0, 0 };
+    for(uint8_t i = 0; i < 2; i++) {
+      if(s_motor[i]) { pos[i] = (*s_motor[i])->get_current_position(); }
+    }
+
+    TIMER0_COMPA_vect();
+
+    for(uint8_t i = 0; i < 2; i++) {
+      if(! s_motor[i]) { continue; }
+      const int32_t units = (int32_t) ((*s_motor[i])->get_current_position() - pos[i]);
+      if(units) { printf("# step %llu %u %+d\n", (unsigned long long) s_tick, i + 1, units); }
+    }
+  }
+
+  if((TIMSK2 & bit(OCIE2A)) && (now() % TIMER2_TICK) == 0) { TIMER2_COMPA_vect(); }
+
+  if(s_rx.empty() && host::serial_rx[0].empty() && host::serial_tx[0].empty() && now() >= s_rx_end + s_opt.tail && idle()) { finish(); }
+}
+
+static void usage(const char* name)
+{
+  fprintf(stderr, "usage: %s [--baud N] [--tail SEC] [--eeprom IMAGE] "
+    "[--max-speed N] [--min-speed N] < capture\n", name);
+  exit(2);
+}
+
+int main(int argc, char** argv)
+{
+  for(int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+    if(i + 1 >= argc) { usage(argv[0]); }
+
+    if(arg == "--baud") { s_opt.baud = atol(argv[++i]); }
+    else if(arg == "--tail") { s_opt.tail = (uint64_t) (atof(argv[++i]) * 1e6); }
+    else if(arg == "--eeprom") { s_opt.eeprom = argv[++i]; }
+    else if(arg == "--max-speed") { s_opt.max_speed = atol(argv[++i]); }
+    else if(arg == "--min-speed") { s_opt.min_speed = atol(argv[++i]); }
+    else { usage(argv[0]); }
+  }
+  if(! s_opt.baud) { usage(argv[0]); }
+
+  printf("# ardufocus sim, %u baud, tick %ld us\n", s_opt.baud, TIMER0_TICK);
+  load_capture(stdin);
+  eeprom_image("rb");
+
+  host::on_eeprom_write = eeprom_write;
+  host::on_loop = loop;
+  return ardufocus_main();
+}
@@ -0,0 +1,359 @@
+/**
+ * Ardufocus - Moonlite compatible focuser
+ * Copyright (C) 2017-2019 João Brázio [joao@brazio.org]
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * TMC2209 driver tests against a register level stub of the chip, build and
+ * run with "make test" from this directory. The stub decodes the datagrams
+ * bit banged on the UART pin by sampling it on every bit time delay, the
+ * register values are checked against the datasheet formulas.
+ */
+
+// Ahead of the firmware headers, macro.h redefines some of their names
+#include <math.h>
+#include <map>
+#include <new>
+#include <vector>
+
+#include "tmc2209.h"
+
+#ifdef HIGH_RESOLUTION_MODE
+  static const bool s_hires = true;
+#else
+  static const bool s_hires = false;
+#endif
+
+static int s_failures = 0;
+
+#define CHECK(expr) do { \
+    if(! (expr)) { \
+      fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #expr); \
+      ++s_failures; \
+    } \
+  } while(0)
+
+#define GCONF       0x00
+#define IHOLD_IRUN  0x10
+#define TPOWERDOWN  0x11
+#define TCOOLTHRS   0x14
+#define SGTHRS      0x40
+#define CHOPCONF    0x6C
+
+static const tmc2209::pinout_t s_pinout = { 20, 21, 22, 23, 24 };
+
+/**
+ * @brief   Register level stub of the chip
+ * @details Bit time delays sample the UART pin, any other delay with the
+ *          step pin high is the width of a step pulse.
+ */
+class chip {
+  private:
+    const tmc2209::pinout_t m_pinout;
+    std::vector<uint8_t> m_bits;
+    std::vector<uint8_t> m_datagram;
+
+    // Datasheet CRC8, polynomial x^8 + x^2 + x + 1 over the bytes LSB first
+    static uint8_t crc8(const std::vector<uint8_t>& data, const size_t& len) {
+      uint8_t crc = 0;
+      for(size_t i = 0; i < len; i++) {
+        for(uint8_t j = 0; j < 8; j++) {
+          const bool in = ((data[i] >> j) & 0x01) ^ (crc >> 7);
+          crc = (uint8_t) (crc << 1) ^ (in ? 0x07 : 0x00);
+        }
+      }
+      return crc;
+    }
+
+    void sample() {
+      m_bits.push_back(host::pin_level[m_pinout.uart] ? 1 : 0);
+      if(m_bits.size() < 10) { return; }
+
+      // start bit, 8 data bits LSB first and the stop bit
+      if(m_bits[0] != 0 || m_bits[9] != 1) { ++framing_errors; }
+      uint8_t b = 0;
+      for(uint8_t i = 0; i < 8; i++) { b |= m_bits[i + 1] << i; }
+      m_bits.clear();
+
+      m_datagram.push_back(b);
+      if(m_datagram.size() < 8) { return; }
+
+      if(m_datagram[0] != 0x05 || ! (m_datagram[2] & 0x80)) { ++framing_errors; }
+      else if(crc8(m_datagram, 7) != m_datagram[7]) { ++crc_errors; }
+      else {
+        address = m_datagram[1];
+        regs[m_datagram[2] & 0x7F] = ((uint32_t) m_datagram[3] << 24) | ((uint32_t) m_datagram[4] << 16)
+                                   | ((uint32_t) m_datagram[5] <<  8) | m_datagram[6];
+        ++writes;
+      }
+      m_datagram.clear();
+    }
+
+  public:
+    std::map<uint8_t, uint32_t> regs;
+    uint8_t address = 0xFF;
+    size_t writes = 0, crc_errors = 0, framing_errors = 0, pulses = 0;
+
+    chip(const tmc2209::pinout_t& pinout): m_pinout(pinout) {
+      memset((void*) host::pin_level, 0, sizeof(host::pin_level));
+      host::on_delay_us = [this](const double& us) {
+        if(fabs(us - 1000000.0 / TMC2209_UART_BAUD) < 0.5) { sample(); }
+        else if(host::pin_level[m_pinout.step]) { ++pulses; }
+      };
+    }
+
+    ~chip() { host::on_delay_us = nullptr; }
+
+    bool idle() { return m_bits.empty() && m_datagram.empty(); }
+    uint8_t mres() { return (regs[CHOPCONF] >> 24) & 0x0F; }
+};
+
+// The firmware drivers are globals, zeroed before they are constructed
+template<class T> class global {
+  private:
+    T* const m_ptr;
+
+  public:
+    global(const tmc2209::pinout_t& pinout, const tmc2209::config_t& config)
+      : m_ptr(new(calloc(1, sizeof(T))) T(pinout, config)) { ; }
+    ~global() { m_ptr->~T(); free(m_ptr); }
+
+    T* operator->() { return m_ptr; }
+    T& operator*() { return *m_ptr; }
+};
+
+// Exposes the homing state
+class probe: public tmc2209 {
+  public:
+    using tmc2209::tmc2209;
+    bool homing() { return m_homing; }
+};
+
+// Largest CS whose RMS current does not exceed the setting, VFS = 325mV
+static uint8_t expected_cs(const uint16_t& ma)
+{
+  const double r = (TMC2209_RSENSE + 20) / 1000.0;
+  uint8_t cs = 0;
+  for(uint8_t n = 0; n < 32; n++) {
+    if((n + 1) / 32.0 * 0.325 / r / sqrt(2.0) * 1000.0 <= ma) { cs = n; }
+  }
+  return cs;
+}
+
+// TSTEP below which DIAG is armed, one step is 2^MRES microsteps of 1/256
+static uint32_t expected_tcoolthrs(const uint8_t& mres)
+{
+  const uint32_t t = 12000000UL / ((uint32_t) TMC2209_STALL_MIN_SPEED * (1UL << mres));
+  return (t > 0xFFFFF) ? 0xFFFFF : t;
+}
+
+static void test_init()
+{
+  chip c(s_pinout);
+  global<tmc2209> drv(s_pinout, { 3, 500, 16, 50 });
+  drv->init();
+
+  CHECK(c.idle());
+  CHECK(c.crc_errors == 0);
+  CHECK(c.framing_errors == 0);
+  CHECK(c.writes == 6);
+  CHECK(c.address == 3);
+  CHECK(host::pin_level[s_pinout.uart] == 1);
+
+  CHECK(c.regs[GCONF] == 0x1C0);
+  CHECK(c.regs[TPOWERDOWN] == 20);
+  CHECK(c.regs[SGTHRS] == 50);
+  CHECK((c.regs[CHOPCONF] & ~0x0F000000UL) == 0x10000053UL);
+  CHECK(c.mres() == 4);
+  CHECK(c.regs[TCOOLTHRS] == expected_tcoolthrs(4));
+  CHECK(drv->get_step_mode() == 0xFF);
+}
+
+static void test_current()
+{
+  const uint16_t currents[] = { 30, 100, 250, 500, 800, 1200, 1700, 2000, 3000 };
+
+  for(const uint16_t ma: currents) {
+    chip c(s_pinout);
+    global<tmc2209> drv(s_pinout, { 0, ma, 16, 0 });
+    drv->init();
+
+    const uint32_t v = c.regs[IHOLD_IRUN];
+    const uint8_t cs = expected_cs(ma);
+    CHECK(c.crc_errors == 0);
+    CHECK(((v >> 16) & 0x0F) == 8);       // IHOLDDELAY
+    CHECK(((v >>  8) & 0x1F) == cs);      // IRUN
+    CHECK((v & 0x1F) == (uint32_t) (cs >> 1)); // IHOLD
+    if(((v >> 8) & 0x1F) != cs) { fprintf(stderr, "  %umA: IRUN %u, expected %u\n", ma, (v >> 8) & 0x1F, cs); }
+  }
+}
+
+static void test_mres()
+{
+  // Resolution selected by MOTORn_TMC2209_MICROSTEPS
+  const uint16_t microsteps[] = { 1, 2, 4, 8, 16, 32, 64, 128, 256 };
+  for(uint8_t i = 0; i < 9; i++) {
+    chip c(s_pinout);
+    global<tmc2209> drv(s_pinout, { 0, 500, microsteps[i], 50 });
+    drv->init();
+
+    CHECK(c.mres() == 8 - i);
+    CHECK(c.regs[TCOOLTHRS] == expected_tcoolthrs(8 - i));
+    CHECK(drv->get_step_mode() == ((i == 0) ? 0x00 : 0xFF));
+  }
+
+  // Resolution selected by the stepping mode commands
+  chip c(s_pinout);
+  global<tmc2209> drv(s_pinout, { 0, 500, 16, 50 });
+  drv->init();
+
+  drv->set_full_step();
+  CHECK(c.mres() == 8);
+  CHECK(c.regs[TCOOLTHRS] == expected_tcoolthrs(8));
+  CHECK(drv->get_step_mode() == 0x00);
+
+  drv->set_half_step();
+  CHECK(c.mres() == 7);
+  CHECK(c.regs[TCOOLTHRS] == expected_tcoolthrs(7));
+  CHECK(drv->get_step_mode() == 0xFF);
+
+  drv->set_quarter_step();
+  CHECK(c.mres() == 6);
+  CHECK(c.regs[TCOOLTHRS] == expected_tcoolthrs(6));
+  CHECK(c.crc_errors == 0);
+
+  // Without StallGuard DIAG is never armed
+  chip d(s_pinout);
+  global<tmc2209> off(s_pinout, { 0, 500, 256, 0 });
+  off->init();
+  CHECK(d.mres() == 0);
+  CHECK(d.regs[TCOOLTHRS] == 0);
+  CHECK(d.regs[SGTHRS] == 0);
+  off->set_full_step();
+  CHECK(d.regs[TCOOLTHRS] == 0);
+}
+
+// Runs the step timer until the motor stops or the tick budget runs out
+static bool run(tmc2209& motor, uint32_t ticks, const std::function<bool()>& until = nullptr)
+{
+  while(ticks--) {
+    motor.tick();
+    if(! motor.is_moving()) { return true; }
+    if(until && until()) { return true; }
+  }
+  return false;
+}
+
+static void test_stall_move()
+{
+  chip c(s_pinout);
+  global<tmc2209> drv(s_pinout, { 0, 500, 16, 50 });
+  drv->init();
+
+  drv->set_current_position(100);
+  drv->set_target_position(1000);
+  drv->move();
+  CHECK(run(*drv, 100000, [&]() { return drv->get_current_position() >= 150; }));
+  CHECK(drv->is_moving());
+  CHECK(c.pulses == 50);
+
+  // A stall halts the move on the next step, that step is not taken
+  const uint32_t pos = drv->get_current_position();
+  const size_t pulses = c.pulses;
+  host::pin_level[s_pinout.diag] = 1;
+  CHECK(run(*drv, 100000));
+
+  CHECK(! drv->is_moving());
+  CHECK(drv->get_stalls() == 1);
+  CHECK(drv->get_current_position() == pos);
+  CHECK(drv->get_target_position() == pos);
+  CHECK(c.pulses == pulses);
+
+  // Every stalled move counts once
+  drv->set_target_position(50);
+  drv->move();
+  CHECK(run(*drv, 100000));
+  CHECK(drv->get_stalls() == 2);
+  CHECK(drv->get_current_position() == pos);
+
+  // DIAG is ignored when StallGuard is disabled
+  chip d(s_pinout);
+  global<tmc2209> off(s_pinout, { 0, 500, 16, 0 });
+  off->init();
+  host::pin_level[s_pinout.diag] = 1;
+  off->set_current_position(100);
+  off->set_target_position(120);
+  off->move();
+  CHECK(run(*off, 100000));
+  CHECK(off->get_current_position() == 120);
+  CHECK(off->get_stalls() == 0);
+  CHECK(d.pulses == 20);
+}
+
+static void test_stall_home()
+{
+  chip c(s_pinout);
+  global<probe> drv(s_pinout, { 0, 500, 16, 50 });
+  drv->init();
+
+  const uint32_t far = s_hires ? 0x7FFFFFFFUL : 0xFFFFUL;
+  CHECK(drv->home());
+  CHECK(drv->homing());
+  CHECK(drv->is_moving());
+  CHECK(drv->get_target_position() == 0);
+  CHECK(run(*drv, 100000, [&]() { return drv->get_current_position() <= far - 20; }));
+  CHECK(drv->get_current_position() == far - 20);
+
+  // The stall point becomes the zero position, not a stall event
+  const size_t pulses = c.pulses;
+  host::pin_level[s_pinout.diag] = 1;
+  CHECK(run(*drv, 100000));
+
+  CHECK(! drv->is_moving());
+  CHECK(! drv->homing());
+  CHECK(drv->get_current_position() == 0);
+  CHECK(drv->get_target_position() == 0);
+  CHECK(drv->get_stalls() == 0);
+  CHECK(c.pulses == pulses);
+
+  // A later stall is counted again
+  drv->set_target_position(100);
+  drv->move();
+  CHECK(run(*drv, 100000));
+  CHECK(drv->get_stalls() == 1);
+
+  // Homing needs StallGuard
+  chip d(s_pinout);
+  global<probe> off(s_pinout, { 0, 500, 16, 0 });
+  off->init();
+  CHECK(! off->home());
+  CHECK(! off->homing());
+  CHECK(! off->is_moving());
+}
+
+int main()
+{
+  test_init();
+  test_current();
+  test_mres();
+  test_stall_move();
+  test_stall_home();
+
+  printf("tmc2209 %s: %s\n", s_hires ? "high resolution" : "standard",
+    s_failures ? "FAILED" : "passed");
+  return s_failures ? 1 : 0;
+}